@@ -0,0 +1,337 @@
+#include "benchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <execution>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "search_server.h"
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// splitmix64: cheap to seed, so every document can get a generator of its own
+class Random {
+public:
+    explicit Random(uint64_t seed)
+        : state_(seed) {
+    }
+
+    uint64_t Next() {
+        uint64_t value = (state_ += 0x9e3779b97f4a7c15ull);
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+        return value ^ (value >> 31);
+    }
+    // uniform in [0, 1)
+    double NextDouble() {
+        return (Next() >> 11) * 0x1.0p-53;
+    }
+    size_t NextIndex(size_t size) {
+        return static_cast<size_t>(NextDouble() * size);
+    }
+
+private:
+    uint64_t state_;
+};
+
+class Workload {
+public:
+    explicit Workload(const BenchmarkOptions& options)
+        : options_(options) {
+        if (options.vocabulary_size <= options.stop_word_count || options.words_per_document == 0 || options.words_per_query == 0) {
+            throw std::invalid_argument(std::string("Invalid benchmark options"));
+        }
+        cdf_.reserve(options.vocabulary_size);
+        double sum = 0.0;
+        for (size_t rank = 1; rank <= options.vocabulary_size; ++rank) {
+            sum += 1.0 / std::pow(static_cast<double>(rank), options.zipf_exponent);
+            cdf_.push_back(sum);
+        }
+        for (double& value : cdf_) {
+            value /= sum;
+        }
+    }
+
+    std::string StopWords() const {
+        std::string text;
+        for (size_t rank = 0; rank < options_.stop_word_count; ++rank) {
+            text += Word(rank) + ' ';
+        }
+        return text;
+    }
+
+    std::string Document(int document_id) const {
+        Random random = DocumentRandom(document_id);
+        if (document_id > 0 && random.NextDouble() < options_.duplicate_share) {
+            // the same words as an earlier document, rotated
+            const int original_id = static_cast<int>(random.NextIndex(document_id));
+            std::vector<std::string> words = Split(Document(original_id));
+            std::rotate(words.begin(), words.begin() + random.NextIndex(words.size()), words.end());
+            return Join(words);
+        }
+        const size_t length = options_.words_per_document / 2 + random.NextIndex(options_.words_per_document + 1);
+        std::string text;
+        for (size_t i = 0; i < std::max<size_t>(length, 1); ++i) {
+            text += Word(SampleRank(random)) + ' ';
+        }
+        return text;
+    }
+
+    std::vector<std::string> Queries() const {
+        Random random(options_.seed ^ 0x5157455259ull);
+        std::vector<std::string> queries(options_.query_count);
+        for (auto& query : queries) {
+            for (size_t i = 0; i < options_.words_per_query; ++i) {
+                query += Word(SampleRank(random)) + ' ';
+            }
+            if (random.NextDouble() < options_.minus_word_share) {
+                query += '-' + Word(SampleRank(random));
+            }
+        }
+        return queries;
+    }
+
+private:
+    const BenchmarkOptions& options_;
+    std::vector<double> cdf_;
+
+    Random DocumentRandom(int document_id) const {
+        Random mix(options_.seed + static_cast<uint64_t>(document_id));
+        return Random(mix.Next());
+    }
+
+    size_t SampleRank(Random& random) const {
+        const auto it = std::upper_bound(cdf_.begin(), cdf_.end(), random.NextDouble());
+        return std::min<size_t>(it - cdf_.begin(), cdf_.size() - 1);
+    }
+
+    // base-26 spelling of the rank, so frequent words are short like in natural text
+    static std::string Word(size_t rank) {
+        std::string word;
+        do {
+            word += static_cast<char>('a' + rank % 26);
+            rank /= 26;
+        } while (rank > 0);
+        return word;
+    }
+
+    static std::vector<std::string> Split(const std::string& text) {
+        std::istringstream in(text);
+        std::vector<std::string> words;
+        for (std::string word; in >> word;) {
+            words.push_back(std::move(word));
+        }
+        return words;
+    }
+
+    static std::string Join(const std::vector<std::string>& words) {
+        std::string text;
+        for (const auto& word : words) {
+            text += word + ' ';
+        }
+        return text;
+    }
+};
+
+size_t GetPeakRssKilobytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss) / 1024;
+#else
+    return static_cast<size_t>(usage.ru_maxrss);
+#endif
+#endif
+}
+
+// Times operation(i) for every i < operation_count; setup(i) runs before it and is not timed
+template <typename Operation, typename Setup>
+BenchmarkResult Measure(const std::string& name, size_t operation_count, Operation operation, Setup setup) {
+    std::vector<double> latencies(operation_count);
+    for (size_t i = 0; i < operation_count; ++i) {
+        setup(i);
+        const auto operation_start = Clock::now();
+        operation(i);
+        latencies[i] = std::chrono::duration<double, std::micro>(Clock::now() - operation_start).count();
+    }
+    BenchmarkResult result;
+    result.name = name;
+    result.operations = operation_count;
+    result.seconds = std::accumulate(latencies.begin(), latencies.end(), 0.0) / 1e6;
+    result.operations_per_second = result.seconds > 0.0 ? operation_count / result.seconds : 0.0;
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        result.p50_microseconds = latencies[latencies.size() / 2];
+        result.p99_microseconds = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+    }
+    result.peak_rss_kilobytes = GetPeakRssKilobytes();
+    return result;
+}
+
+template <typename Operation>
+BenchmarkResult Measure(const std::string& name, size_t operation_count, Operation operation) {
+    return Measure(name, operation_count, operation, [](size_t) {});
+}
+
+void PrintJsonString(std::ostream& out, std::string_view text) {
+    out << '"';
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\';
+        }
+        out << c;
+    }
+    out << '"';
+}
+}
+
+BenchmarkOptions ParseBenchmarkOptions(const std::vector<std::string_view>& args) {
+    BenchmarkOptions options;
+    for (const std::string_view arg : args) {
+        const size_t equals = arg.find('=');
+        if (equals == std::string_view::npos) {
+            throw std::invalid_argument("Benchmark option " + std::string(arg) + " is not key=value");
+        }
+        const std::string key(arg.substr(0, equals));
+        std::istringstream value{ std::string(arg.substr(equals + 1)) };
+        const auto read = [&](auto& field) {
+            if (!(value >> field) || !value.eof()) {
+                throw std::invalid_argument("Benchmark option " + std::string(arg) + " has an invalid value");
+            }
+        };
+        if (key == "document_count") read(options.document_count);
+        else if (key == "vocabulary_size") read(options.vocabulary_size);
+        else if (key == "zipf_exponent") read(options.zipf_exponent);
+        else if (key == "words_per_document") read(options.words_per_document);
+        else if (key == "stop_word_count") read(options.stop_word_count);
+        else if (key == "duplicate_share") read(options.duplicate_share);
+        else if (key == "query_count") read(options.query_count);
+        else if (key == "words_per_query") read(options.words_per_query);
+        else if (key == "minus_word_share") read(options.minus_word_share);
+        else if (key == "process_queries_batch") read(options.process_queries_batch);
+        else if (key == "remove_count") read(options.remove_count);
+        else if (key == "seed") read(options.seed);
+        else throw std::invalid_argument("Unknown benchmark option " + key);
+    }
+    return options;
+}
+
+std::vector<BenchmarkResult> RunBenchmarks(const BenchmarkOptions& options) {
+    const Workload workload(options);
+    const std::vector<std::string> queries = workload.Queries();
+    const size_t query_count = queries.size();
+    SearchServer search_server(workload.StopWords());
+    std::vector<BenchmarkResult> results;
+
+    // generating a document is not part of its timing
+    std::string text;
+    results.push_back(Measure("add_document", options.document_count, [&](size_t i) {
+        search_server.AddDocument(static_cast<int>(i), text, DocumentStatus::ACTUAL, { static_cast<int>(i % 11) - 5 });
+    }, [&](size_t i) {
+        text = workload.Document(static_cast<int>(i));
+    }));
+
+    results.push_back(Measure("find_top_documents_seq", query_count, [&](size_t i) {
+        search_server.FindTopDocuments(std::execution::seq, queries[i]);
+    }));
+    results.push_back(Measure("find_top_documents_par", query_count, [&](size_t i) {
+        search_server.FindTopDocuments(std::execution::par, queries[i]);
+    }));
+    Random random(options.seed ^ 0x4d41544348ull);
+    std::vector<int> match_ids(query_count);
+    for (int& id : match_ids) {
+        id = static_cast<int>(random.NextIndex(options.document_count));
+    }
+    results.push_back(Measure("match_document", query_count, [&](size_t i) {
+        search_server.MatchDocument(queries[i], match_ids[i]);
+    }));
+    // one query against the ids of a whole result page, as highlighting does
+    constexpr size_t MATCH_DOCUMENTS_IDS = 100;
+    std::vector<int> page_ids(std::min(MATCH_DOCUMENTS_IDS, options.document_count));
+    for (int& id : page_ids) {
+        id = static_cast<int>(random.NextIndex(options.document_count));
+    }
+    results.push_back(Measure("match_documents_par", query_count, [&](size_t i) {
+        search_server.MatchDocuments(std::execution::par, queries[i], page_ids);
+    }));
+    const size_t batch_size = std::max<size_t>(options.process_queries_batch, 1);
+    std::vector<std::vector<std::string>> batches;
+    for (size_t begin = 0; begin < query_count; begin += batch_size) {
+        batches.emplace_back(queries.begin() + begin, queries.begin() + std::min(query_count, begin + batch_size));
+    }
+    results.push_back(Measure("process_queries", batches.size(), [&](size_t i) {
+        ProcessQueries(search_server, batches[i]);
+    }));
+
+    // RemoveDuplicates reports every removal on std::cout, which would break the JSON output
+    std::ostringstream removal_log;
+    auto* const cout_buffer = std::cout.rdbuf(removal_log.rdbuf());
+    try {
+        results.push_back(Measure("remove_duplicates", 1, [&](size_t) {
+            RemoveDuplicates(search_server);
+        }));
+    } catch (...) {
+        std::cout.rdbuf(cout_buffer);
+        throw;
+    }
+    std::cout.rdbuf(cout_buffer);
+
+    std::vector<int> remove_ids(search_server.begin(), search_server.end());
+    std::shuffle(remove_ids.begin(), remove_ids.end(), std::mt19937_64(options.seed));
+    remove_ids.resize(std::min(remove_ids.size(), options.remove_count));
+    results.push_back(Measure("remove_document", remove_ids.size(), [&](size_t i) {
+        search_server.RemoveDocument(remove_ids[i]);
+    }));
+    return results;
+}
+
+void PrintBenchmarkResults(const BenchmarkOptions& options, const std::vector<BenchmarkResult>& results, std::ostream& out) {
+    out << "{\"options\": {"
+        << "\"document_count\": " << options.document_count
+        << ", \"vocabulary_size\": " << options.vocabulary_size
+        << ", \"zipf_exponent\": " << options.zipf_exponent
+        << ", \"words_per_document\": " << options.words_per_document
+        << ", \"stop_word_count\": " << options.stop_word_count
+        << ", \"duplicate_share\": " << options.duplicate_share
+        << ", \"query_count\": " << options.query_count
+        << ", \"words_per_query\": " << options.words_per_query
+        << ", \"minus_word_share\": " << options.minus_word_share
+        << ", \"process_queries_batch\": " << options.process_queries_batch
+        << ", \"remove_count\": " << options.remove_count
+        << ", \"seed\": " << options.seed
+        << "},\n\"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& result = results[i];
+        out << (i == 0 ? "\n" : ",\n") << "  {\"name\": ";
+        PrintJsonString(out, result.name);
+        out << ", \"operations\": " << result.operations
+            << ", \"seconds\": " << result.seconds
+            << ", \"operations_per_second\": " << result.operations_per_second
+            << ", \"p50_us\": " << result.p50_microseconds
+            << ", \"p99_us\": " << result.p99_microseconds
+            << ", \"peak_rss_kb\": " << result.peak_rss_kilobytes << "}";
+    }
+    out << "\n]}" << std::endl;
+}
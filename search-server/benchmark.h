@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Synthetic workload for the SearchServer hot paths. Document and query words follow a Zipf distribution
+// over a fixed vocabulary, and every document is generated from the seed and its id alone, so two builds
+// given the same options index exactly the same corpus and run exactly the same queries.
+struct BenchmarkOptions {
+    size_t document_count = 1'000'000;
+    size_t vocabulary_size = 200'000;
+    double zipf_exponent = 1.0;
+    // document lengths are uniform in [words_per_document / 2, words_per_document * 3 / 2]
+    size_t words_per_document = 40;
+    size_t stop_word_count = 3;
+    // share of documents that repeat the words of an earlier one in another order
+    double duplicate_share = 0.01;
+    size_t query_count = 10'000;
+    size_t words_per_query = 3;
+    double minus_word_share = 0.2;
+    size_t process_queries_batch = 1'000;
+    size_t remove_count = 10'000;
+    uint64_t seed = 42;
+};
+
+// Reads key=value pairs named after the BenchmarkOptions fields
+BenchmarkOptions ParseBenchmarkOptions(const std::vector<std::string_view>& args);
+
+struct BenchmarkResult {
+    std::string name;
+    size_t operations = 0;
+    double seconds = 0.0;
+    double operations_per_second = 0.0;
+    // latency of one operation, or of one batch for the batched benchmarks
+    double p50_microseconds = 0.0;
+    double p99_microseconds = 0.0;
+    size_t peak_rss_kilobytes = 0;
+};
+
+// Runs, in order: AddDocument, FindTopDocuments seq and par, MatchDocument, MatchDocuments over 100 ids,
+// ProcessQueries, RemoveDuplicates and RemoveDocument, all on one server
+std::vector<BenchmarkResult> RunBenchmarks(const BenchmarkOptions& options);
+
+// Writes the options and results as one JSON object
+void PrintBenchmarkResults(const BenchmarkOptions& options, const std::vector<BenchmarkResult>& results, std::ostream& out);
@@ -0,0 +1,107 @@
+#include "concurrent_search_server.h"
+#include <functional>
+#include <thread>
+
+ConcurrentSearchServer::ConcurrentSearchServer(const std::string& stop_words_text)
+    : ConcurrentSearchServer(SplitIntoWords(stop_words_text)) {
+}
+
+ConcurrentSearchServer::ConcurrentSearchServer(const std::string_view stop_words_text)
+    : ConcurrentSearchServer(SplitIntoWords(stop_words_text)) {
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    Update([&](SearchServer& server) {
+        server.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+void ConcurrentSearchServer::AddDocuments(const std::vector<SearchServer::NewDocument>& documents) {
+    Update([&documents](SearchServer& server) {
+        server.AddDocuments(documents);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    Update([document_id](SearchServer& server) {
+        server.RemoveDocument(document_id);
+    });
+}
+
+void ConcurrentSearchServer::Compact(PostingFormat format) {
+    Update([format](SearchServer& server) {
+        server.Compact(format);
+    });
+    format_ = format;
+}
+
+std::vector<Document> ConcurrentSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status,
+    size_t top_count) const {
+    return Read([&](const SearchServer& server) {
+        return server.FindTopDocuments(raw_query, status, top_count);
+    });
+}
+
+std::vector<std::vector<Document>> ConcurrentSearchServer::FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+    DocumentStatus status, size_t top_count) const {
+    return Read([&](const SearchServer& server) {
+        return server.FindTopDocumentsBatch(raw_queries, status, top_count);
+    });
+}
+
+SearchServer::MatchResult ConcurrentSearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
+    return Read([&](const SearchServer& server) {
+        return server.MatchDocument(raw_query, document_id);
+    });
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const {
+    return Read([](const SearchServer& server) {
+        return server.GetDocumentCount();
+    });
+}
+
+int ConcurrentSearchServer::Pin(size_t slot) const {
+    // all operations are sequentially consistent: a reader that pins the old copy after the writer has
+    // seen its counter at zero re-reads published_ after the writer's store, and backs off
+    while (true) {
+        const int instance = published_.load();
+        readers_[instance][slot].count.fetch_add(1);
+        if (published_.load() == instance) {
+            return instance;
+        }
+        readers_[instance][slot].count.fetch_sub(1);
+    }
+}
+
+void ConcurrentSearchServer::Unpin(int instance, size_t slot) const {
+    readers_[instance][slot].count.fetch_sub(1);
+}
+
+void ConcurrentSearchServer::WaitForReaders(int instance) const {
+    for (const auto& reader_slot : readers_[instance]) {
+        while (reader_slot.count.load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void ConcurrentSearchServer::RebuildStale() {
+    if (stale_ < 0) {
+        return;
+    }
+    const SearchServer& source = *instances_[1 - stale_];
+    auto rebuilt = std::make_unique<SearchServer>(stop_words_);
+    rebuilt->SetPositionIndexing(source.GetPositionIndexing());
+    rebuilt->ImportDocuments(source, [](int) {
+        return true;
+    });
+    rebuilt->Compact(format_);
+    instances_[stale_] = std::move(rebuilt);
+    stale_ = -1;
+}
+
+size_t ConcurrentSearchServer::GetReaderSlot() {
+    thread_local const size_t slot = std::hash<std::thread::id>{}(std::this_thread::get_id()) % READER_SLOT_COUNT;
+    return slot;
+}
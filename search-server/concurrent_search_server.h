@@ -0,0 +1,121 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "document.h"
+#include "search_server.h"
+
+// SearchServer that can be searched while it is being updated (left-right scheme). Two copies of the index
+// are kept: readers pin whichever one is published and never wait, a writer updates the other copy,
+// publishes it with one atomic store, waits for the readers still pinning the old copy and replays the
+// update there. Updates are serialized among themselves and cost twice a plain one; memory is doubled.
+// A copy an update failed on is rebuilt from the other one, so the two never diverge.
+class ConcurrentSearchServer {
+public:
+    template <typename StringContainer>
+    explicit ConcurrentSearchServer(const StringContainer& stop_words);
+    explicit ConcurrentSearchServer(const std::string& stop_words_text);
+    explicit ConcurrentSearchServer(const std::string_view stop_words_text);
+
+    // func(const SearchServer&) runs against a consistent published index
+    template <typename Func>
+    auto Read(Func func) const;
+    // func(SearchServer&) is applied to both copies, so it must do the same thing both times. If it throws,
+    // the exception is rethrown after the copy it threw on is rebuilt from the other one (documents, position
+    // indexing and posting format; not the result cache): on the first copy nothing is published, on the
+    // second the update stays applied. A rebuild that fails itself is retried before the next update.
+    template <typename Func>
+    void Update(Func func);
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void AddDocuments(const std::vector<SearchServer::NewDocument>& documents);
+    void RemoveDocument(int document_id);
+    void Compact(PostingFormat format = PostingFormat::PLAIN);
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+        size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+        DocumentStatus status = DocumentStatus::ACTUAL, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    // The matched words point into the index dictionary, which only grows, so they outlive later updates
+    SearchServer::MatchResult MatchDocument(const std::string_view raw_query, int document_id) const;
+    int GetDocumentCount() const;
+
+private:
+    static constexpr size_t READER_SLOT_COUNT = 16;
+
+    // pin counters are striped over cache lines so that readers on different threads don't contend
+    struct alignas(64) ReaderSlot {
+        std::atomic<int64_t> count = 0;
+    };
+
+    const std::vector<std::string> stop_words_;
+    std::array<std::unique_ptr<SearchServer>, 2> instances_;
+    std::atomic<int> published_ = 0;
+    // the copy to rebuild before the next update, -1 if none
+    int stale_ = -1;
+    PostingFormat format_ = PostingFormat::PLAIN;
+    mutable std::array<std::array<ReaderSlot, READER_SLOT_COUNT>, 2> readers_;
+    std::mutex update_mutex_;
+
+    // Returns the index of the pinned copy
+    int Pin(size_t slot) const;
+    void Unpin(int instance, size_t slot) const;
+    void WaitForReaders(int instance) const;
+    // Replaces the stale copy, which no reader pins, with one imported from the other copy
+    void RebuildStale();
+    template <typename Func>
+    void Apply(Func& func, int instance);
+    static size_t GetReaderSlot();
+};
+
+template <typename StringContainer>
+ConcurrentSearchServer::ConcurrentSearchServer(const StringContainer& stop_words)
+    : stop_words_(std::begin(stop_words), std::end(stop_words))
+    , instances_{ std::make_unique<SearchServer>(stop_words_), std::make_unique<SearchServer>(stop_words_) } {
+}
+
+template <typename Func>
+auto ConcurrentSearchServer::Read(Func func) const {
+    const size_t slot = GetReaderSlot();
+    const int instance = Pin(slot);
+    struct Unpinner {
+        const ConcurrentSearchServer* server;
+        int instance;
+        size_t slot;
+        ~Unpinner() {
+            server->Unpin(instance, slot);
+        }
+    } unpinner{ this, instance, slot };
+    return func(static_cast<const SearchServer&>(*instances_[instance]));
+}
+
+template <typename Func>
+void ConcurrentSearchServer::Update(Func func) {
+    std::lock_guard guard(update_mutex_);
+    RebuildStale();
+    const int old_instance = published_.load();
+    Apply(func, 1 - old_instance);
+    published_.store(1 - old_instance);
+    WaitForReaders(old_instance);
+    Apply(func, old_instance);
+}
+
+template <typename Func>
+void ConcurrentSearchServer::Apply(Func& func, int instance) {
+    try {
+        func(*instances_[instance]);
+    } catch (...) {
+        stale_ = instance;
+        try {
+            RebuildStale();
+        } catch (...) {
+        }
+        throw;
+    }
+}
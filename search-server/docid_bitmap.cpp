@@ -0,0 +1,148 @@
+#include "docid_bitmap.h"
+#include <algorithm>
+#include <bit>
+
+bool DocIdBitmap::Group::IsBitset() const {
+    return !bits.empty();
+}
+
+bool DocIdBitmap::Group::Contains(uint16_t value) const {
+    if (IsBitset()) {
+        return (bits[value >> 6] >> (value & 63)) & 1;
+    }
+    return std::binary_search(values.begin(), values.end(), value);
+}
+
+size_t DocIdBitmap::Group::NextAbsent(size_t value) const {
+    if (!IsBitset()) {
+        auto it = std::lower_bound(values.begin(), values.end(), static_cast<uint16_t>(value));
+        for (; it != values.end() && *it == value; ++it) {
+            ++value;
+        }
+        return value;
+    }
+    size_t word = value >> 6;
+    // bits below value count as present
+    uint64_t absent = ~(bits[word] | ((uint64_t{ 1 } << (value & 63)) - 1));
+    while (absent == 0 && ++word < WORD_COUNT) {
+        absent = ~bits[word];
+    }
+    return word == WORD_COUNT ? GROUP_SIZE : word * 64 + std::countr_zero(absent);
+}
+
+bool DocIdBitmap::Add(int document_id) {
+    const uint16_t key = static_cast<uint16_t>(static_cast<uint32_t>(document_id) >> 16);
+    const uint16_t value = static_cast<uint16_t>(document_id);
+    const auto key_it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    auto group_it = groups_.begin() + (key_it - keys_.begin());
+    if (key_it == keys_.end() || *key_it != key) {
+        keys_.insert(key_it, key);
+        group_it = groups_.insert(group_it, Group());
+    }
+    Group& group = *group_it;
+    if (group.IsBitset()) {
+        uint64_t& word = group.bits[value >> 6];
+        const uint64_t bit = uint64_t{ 1 } << (value & 63);
+        if (word & bit) {
+            return false;
+        }
+        word |= bit;
+    } else {
+        const auto it = std::lower_bound(group.values.begin(), group.values.end(), value);
+        if (it != group.values.end() && *it == value) {
+            return false;
+        }
+        group.values.insert(it, value);
+        if (group.values.size() > ARRAY_MAX_SIZE) {
+            group.bits.assign(WORD_COUNT, 0);
+            for (const uint16_t present : group.values) {
+                group.bits[present >> 6] |= uint64_t{ 1 } << (present & 63);
+            }
+            group.values = std::vector<uint16_t>();
+        }
+    }
+    ++group.size;
+    ++size_;
+    return true;
+}
+
+bool DocIdBitmap::Remove(int document_id) {
+    const uint16_t key = static_cast<uint16_t>(static_cast<uint32_t>(document_id) >> 16);
+    const uint16_t value = static_cast<uint16_t>(document_id);
+    const auto key_it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    if (document_id < 0 || key_it == keys_.end() || *key_it != key) {
+        return false;
+    }
+    const auto group_it = groups_.begin() + (key_it - keys_.begin());
+    Group& group = *group_it;
+    if (group.IsBitset()) {
+        uint64_t& word = group.bits[value >> 6];
+        const uint64_t bit = uint64_t{ 1 } << (value & 63);
+        if (!(word & bit)) {
+            return false;
+        }
+        word &= ~bit;
+    } else {
+        const auto it = std::lower_bound(group.values.begin(), group.values.end(), value);
+        if (it == group.values.end() || *it != value) {
+            return false;
+        }
+        group.values.erase(it);
+    }
+    --group.size;
+    --size_;
+    if (group.size == 0) {
+        keys_.erase(key_it);
+        groups_.erase(group_it);
+    } else if (group.IsBitset() && group.size <= BITSET_MIN_SIZE) {
+        group.values.reserve(group.size);
+        for (size_t present = 0; present < GROUP_SIZE; ++present) {
+            if (group.Contains(static_cast<uint16_t>(present))) {
+                group.values.push_back(static_cast<uint16_t>(present));
+            }
+        }
+        group.bits = std::vector<uint64_t>();
+    }
+    return true;
+}
+
+bool DocIdBitmap::Contains(int document_id) const {
+    if (document_id < 0) {
+        return false;
+    }
+    const Group* group = FindGroup(static_cast<uint16_t>(static_cast<uint32_t>(document_id) >> 16));
+    return group != nullptr && group->Contains(static_cast<uint16_t>(document_id));
+}
+
+int64_t DocIdBitmap::NextAbsent(int64_t document_id) const {
+    while (document_id >= 0 && document_id < (int64_t{ 1 } << 31)) {
+        const Group* group = FindGroup(static_cast<uint16_t>(document_id >> 16));
+        if (group == nullptr) {
+            return document_id;
+        }
+        const size_t value = group->size == GROUP_SIZE ? GROUP_SIZE
+            : group->NextAbsent(static_cast<size_t>(document_id & (GROUP_SIZE - 1)));
+        if (value < GROUP_SIZE) {
+            return (document_id & ~static_cast<int64_t>(GROUP_SIZE - 1)) + static_cast<int64_t>(value);
+        }
+        document_id = ((document_id >> 16) + 1) << 16;
+    }
+    return document_id;
+}
+
+size_t DocIdBitmap::Size() const {
+    return size_;
+}
+
+size_t DocIdBitmap::MemoryUsage() const {
+    size_t bytes = keys_.capacity() * sizeof(uint16_t) + groups_.capacity() * sizeof(Group);
+    for (const Group& group : groups_) {
+        bytes += group.values.capacity() * sizeof(uint16_t) + group.bits.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+const DocIdBitmap::Group* DocIdBitmap::FindGroup(uint16_t key) const {
+    const auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    return it == keys_.end() || *it != key ? nullptr : &groups_[it - keys_.begin()];
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Roaring-style set of non-negative docids. Ids are grouped by their upper 16 bits; a group is a sorted
+// array of the lower 16 bits until it holds more than ARRAY_MAX_SIZE ids and a 65536-bit bitset from then
+// until it shrinks to BITSET_MIN_SIZE ids, so a group whose size hovers around one threshold isn't
+// converted back and forth. Membership is a binary search over the groups plus a bit test or a short
+// binary search.
+class DocIdBitmap {
+public:
+    static constexpr size_t ARRAY_MAX_SIZE = 4096;
+    static constexpr size_t BITSET_MIN_SIZE = 3072;
+
+    bool Add(int document_id);
+    bool Remove(int document_id);
+    bool Contains(int document_id) const;
+    // Smallest id >= document_id missing from the set; bitsets are scanned a 64-bit word at a time
+    int64_t NextAbsent(int64_t document_id) const;
+
+    size_t Size() const;
+    size_t MemoryUsage() const;
+
+private:
+    static constexpr size_t GROUP_SIZE = size_t{ 1 } << 16;
+    static constexpr size_t WORD_COUNT = GROUP_SIZE / 64;
+
+    struct Group {
+        std::vector<uint16_t> values;
+        std::vector<uint64_t> bits;
+        size_t size = 0;
+
+        bool IsBitset() const;
+        bool Contains(uint16_t value) const;
+        // Smallest value >= value missing from the group, GROUP_SIZE if there is none
+        size_t NextAbsent(size_t value) const;
+    };
+
+    std::vector<uint16_t> keys_;
+    std::vector<Group> groups_;
+    size_t size_ = 0;
+
+    const Group* FindGroup(uint16_t key) const;
+};
@@ -1,6 +1,13 @@
 #pragma once
 #include <iostream>
 
+enum class DocumentStatus {
+    ACTUAL,
+    IRRELEVANT,
+    BANNED,
+    REMOVED,
+};
+
 struct Document {
     Document() = default;
     Document(int id, double relevance, int rating);
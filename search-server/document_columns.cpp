@@ -0,0 +1,59 @@
+#include "document_columns.h"
+#include <stdexcept>
+#include <string>
+
+void DocumentColumns::Insert(int document_id, const DocumentData& data) {
+    if (document_id < 0 || static_cast<size_t>(data.status) >= STATUS_COUNT) {
+        throw std::invalid_argument(std::string("Invalid document data"));
+    }
+    const size_t page_index = static_cast<size_t>(document_id) >> PAGE_BITS;
+    if (page_index >= pages_.size()) {
+        pages_.resize(page_index + 1);
+    }
+    auto& page = pages_[page_index];
+    if (!page) {
+        page = std::make_unique<Page>();
+    }
+    if (Contains(document_id)) {
+        throw std::invalid_argument(std::string("Document with your id has exist yet"));
+    }
+    const size_t offset = document_id & (PAGE_SIZE - 1);
+    page->ratings[offset] = data.rating;
+    page->word_counts[offset] = data.word_count;
+    page->statuses[offset] = static_cast<uint8_t>(data.status);
+    page->status_bits[static_cast<size_t>(data.status)][offset / WORD_BITS] |= uint64_t{ 1 } << (offset % WORD_BITS);
+    ++page->count;
+}
+
+void DocumentColumns::Erase(int document_id) {
+    if (!Contains(document_id)) {
+        return;
+    }
+    const size_t page_index = static_cast<size_t>(document_id) >> PAGE_BITS;
+    auto& page = pages_[page_index];
+    const size_t offset = document_id & (PAGE_SIZE - 1);
+    page->status_bits[page->statuses[offset]][offset / WORD_BITS] &= ~(uint64_t{ 1 } << (offset % WORD_BITS));
+    if (--page->count == 0) {
+        page.reset();
+        while (!pages_.empty() && !pages_.back()) {
+            pages_.pop_back();
+        }
+    }
+}
+
+bool DocumentColumns::Contains(int document_id) const {
+    const Page* page = FindPage(document_id);
+    if (page == nullptr) {
+        return false;
+    }
+    // a slot is taken exactly when the bit of its status is set
+    const size_t offset = document_id & (PAGE_SIZE - 1);
+    return (page->status_bits[page->statuses[offset]][offset / WORD_BITS] >> (offset % WORD_BITS)) & 1;
+}
+
+DocumentData DocumentColumns::At(int document_id) const {
+    if (!Contains(document_id)) {
+        throw std::out_of_range(std::string("Unknown document id"));
+    }
+    return { Rating(document_id), Status(document_id), WordCount(document_id) };
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "document.h"
+
+struct DocumentData {
+    int rating;
+    DocumentStatus status;
+    int word_count;
+};
+
+// Per-document metadata stored column-wise and addressed by docid through a two-level table of pages, so the
+// scoring loop reaches a rating, status or length with two array indexings instead of a map search. A page
+// covers PAGE_SIZE consecutive docids and is allocated on first use; every page also keeps one bitset per
+// status, which lets status filters run before a document is scored.
+class DocumentColumns {
+public:
+    static constexpr int PAGE_BITS = 10;
+    static constexpr size_t PAGE_SIZE = size_t{ 1 } << PAGE_BITS;
+    static constexpr size_t STATUS_COUNT = static_cast<size_t>(DocumentStatus::REMOVED) + 1;
+
+    void Insert(int document_id, const DocumentData& data);
+    void Erase(int document_id);
+
+    bool Contains(int document_id) const;
+    // Throws std::out_of_range for unknown documents
+    DocumentData At(int document_id) const;
+
+    // Unchecked, the document must be present
+    int Rating(int document_id) const;
+    DocumentStatus Status(int document_id) const;
+    int WordCount(int document_id) const;
+    // False for unknown documents
+    bool HasStatus(int document_id, DocumentStatus status) const;
+
+private:
+    static constexpr size_t WORD_BITS = 64;
+    static constexpr size_t PAGE_WORDS = PAGE_SIZE / WORD_BITS;
+
+    struct Page {
+        std::array<int, PAGE_SIZE> ratings;
+        std::array<int, PAGE_SIZE> word_counts;
+        std::array<uint8_t, PAGE_SIZE> statuses{};
+        std::array<std::array<uint64_t, PAGE_WORDS>, STATUS_COUNT> status_bits{};
+        size_t count = 0;
+    };
+
+    std::vector<std::unique_ptr<Page>> pages_;
+
+    const Page* FindPage(int document_id) const;
+};
+
+inline const DocumentColumns::Page* DocumentColumns::FindPage(int document_id) const {
+    const size_t page = static_cast<size_t>(document_id) >> PAGE_BITS;
+    return page < pages_.size() ? pages_[page].get() : nullptr;
+}
+
+inline int DocumentColumns::Rating(int document_id) const {
+    return pages_[static_cast<size_t>(document_id) >> PAGE_BITS]->ratings[document_id & (PAGE_SIZE - 1)];
+}
+
+inline DocumentStatus DocumentColumns::Status(int document_id) const {
+    return static_cast<DocumentStatus>(pages_[static_cast<size_t>(document_id) >> PAGE_BITS]->statuses[document_id & (PAGE_SIZE - 1)]);
+}
+
+inline int DocumentColumns::WordCount(int document_id) const {
+    return pages_[static_cast<size_t>(document_id) >> PAGE_BITS]->word_counts[document_id & (PAGE_SIZE - 1)];
+}
+
+inline bool DocumentColumns::HasStatus(int document_id, DocumentStatus status) const {
+    const Page* page = FindPage(document_id);
+    if (page == nullptr) {
+        return false;
+    }
+    const size_t offset = document_id & (PAGE_SIZE - 1);
+    return (page->status_bits[static_cast<size_t>(status)][offset / WORD_BITS] >> (offset % WORD_BITS)) & 1;
+}
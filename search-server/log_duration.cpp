@@ -1,4 +1,4 @@
-"log_duration.h"
+#include "log_duration.h"
 LogDuration::LogDuration(const std::string& id)
     : id_(id), out_(std::cerr) {
 }
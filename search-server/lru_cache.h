@@ -0,0 +1,95 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t size = 0;
+};
+
+// LRU cache split by key hash into independently locked shards, each holding up to its share of capacity
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class ConcurrentLruCache {
+public:
+    ConcurrentLruCache(size_t capacity, size_t shard_count)
+        : shard_capacity_(std::max<size_t>(1, (capacity + shard_count - 1) / shard_count)), shards_(shard_count) {
+    }
+
+    // A hit makes the entry the most recently used one of its shard
+    std::optional<Value> Find(const Key& key) {
+        Shard& shard = GetShard(key);
+        std::lock_guard guard(shard.mutex);
+        const auto it = shard.index.find(key);
+        if (it == shard.index.end()) {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return it->second->second;
+    }
+
+    void Insert(const Key& key, Value value) {
+        Shard& shard = GetShard(key);
+        std::lock_guard guard(shard.mutex);
+        const auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            it->second->second = std::move(value);
+            shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+            return;
+        }
+        if (shard.entries.size() == shard_capacity_) {
+            shard.index.erase(shard.entries.back().first);
+            shard.entries.pop_back();
+            evictions_.fetch_add(1, std::memory_order_relaxed);
+        }
+        shard.entries.emplace_front(key, std::move(value));
+        shard.index.emplace(key, shard.entries.begin());
+    }
+
+    CacheStats GetStats() const {
+        CacheStats stats;
+        stats.hits = hits_.load(std::memory_order_relaxed);
+        stats.misses = misses_.load(std::memory_order_relaxed);
+        stats.evictions = evictions_.load(std::memory_order_relaxed);
+        for (auto& shard : shards_) {
+            std::lock_guard guard(shard.mutex);
+            stats.size += shard.entries.size();
+        }
+        return stats;
+    }
+
+private:
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<std::pair<Key, Value>> entries;
+        std::unordered_map<Key, typename std::list<std::pair<Key, Value>>::iterator, Hash> index;
+    };
+
+    size_t shard_capacity_;
+    std::vector<Shard> shards_;
+    std::atomic<uint64_t> hits_ = 0;
+    std::atomic<uint64_t> misses_ = 0;
+    std::atomic<uint64_t> evictions_ = 0;
+
+    // The hash is mixed before the shard is chosen: hashes like the identity of std::hash<int> keep regular
+    // low bits, which would crowd keys into few shards, and the shard maps bucket by the same low bits
+    Shard& GetShard(const Key& key) {
+        uint64_t hash = Hash{}(key);
+        hash = (hash ^ (hash >> 33)) * 0xff51afd7ed558ccdULL;
+        hash = (hash ^ (hash >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+        hash ^= hash >> 33;
+        return shards_[hash % shards_.size()];
+    }
+};
@@ -1,6 +1,8 @@
 #include "string_processing.h"
+#include "benchmark.h"
 #include "process_queries.h"
 #include "search_server.h"
+#include "test_example_functions.h"
 
 #include <execution>
 #include <iostream>
@@ -13,7 +15,18 @@ void PrintDocument(const Document& document) {
          << "relevance = "s << document.relevance << ", "s
          << "rating = "s << document.rating << " }"s << endl;
 }
-int main() {
+int main(int argc, char* argv[]) {
+    // search_server --benchmark [key=value ...] prints the benchmark results as JSON
+    if (argc > 1 && argv[1] == "--benchmark"s) {
+        const BenchmarkOptions options = ParseBenchmarkOptions(vector<string_view>(argv + 2, argv + argc));
+        PrintBenchmarkResults(options, RunBenchmarks(options), cout);
+        return 0;
+    }
+    // search_server --test runs the checks of test_example_functions.h
+    if (argc > 1 && argv[1] == "--test"s) {
+        TestSearchServer();
+        return 0;
+    }
     SearchServer search_server("and with"s);
     int id = 0;
     for (
@@ -38,7 +51,7 @@ int main() {
     }
     cout << "Even ids:"s << endl;
     // параллельная версия
-    for (const Document& document : search_server.FindTopDocuments(execution::par, "curly nasty cat"s, [](int document_id, DocumentStatus status, int rating) { return document_id % 2 == 0; })) {
+    for (const Document& document : search_server.FindTopDocuments(execution::par, "curly nasty cat"s, [](int document_id, DocumentStatus, int) { return document_id % 2 == 0; })) {
         PrintDocument(document);
     }
     return 0;
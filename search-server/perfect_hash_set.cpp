@@ -0,0 +1,107 @@
+#include "perfect_hash_set.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+PerfectHashSet::PerfectHashSet(std::vector<std::string_view> strings) {
+    std::sort(strings.begin(), strings.end());
+    strings.erase(std::unique(strings.begin(), strings.end()), strings.end());
+    strings.erase(std::remove(strings.begin(), strings.end(), std::string_view()), strings.end());
+    size_ = strings.size();
+    if (strings.empty()) {
+        return;
+    }
+    // slots are told apart by the 64-bit hashes only, so they must all differ
+    std::vector<uint64_t> hashes(strings.size());
+    for (;; ++seed_) {
+        if (seed_ == MAX_SEED_COUNT) {
+            throw std::runtime_error(std::string("No hash seed separates the strings"));
+        }
+        std::transform(strings.begin(), strings.end(), hashes.begin(), [this](std::string_view str) {
+            return Hash(str, seed_);
+        });
+        std::vector<uint64_t> sorted_hashes = hashes;
+        std::sort(sorted_hashes.begin(), sorted_hashes.end());
+        if (std::adjacent_find(sorted_hashes.begin(), sorted_hashes.end()) == sorted_hashes.end()) {
+            break;
+        }
+    }
+    displacements_.resize(strings.size());
+    std::vector<std::vector<size_t>> buckets(displacements_.size());
+    for (size_t i = 0; i < strings.size(); ++i) {
+        buckets[(hashes[i] >> 32) % buckets.size()].push_back(i);
+    }
+    std::vector<size_t> bucket_order(buckets.size());
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        bucket_order[i] = i;
+    }
+    // the biggest buckets are placed first, while most slots are still free
+    std::stable_sort(bucket_order.begin(), bucket_order.end(), [&buckets](size_t lhs, size_t rhs) {
+        return buckets[lhs].size() > buckets[rhs].size();
+    });
+
+    std::vector<size_t> placed(strings.size());
+    for (size_t slot_count = std::bit_ceil(2 * strings.size());; slot_count *= 2) {
+        std::vector<bool> occupied(slot_count, false);
+        bool is_placed = true;
+        for (size_t bucket_pos = 0; bucket_pos < bucket_order.size() && is_placed; ++bucket_pos) {
+            const auto& bucket = buckets[bucket_order[bucket_pos]];
+            is_placed = false;
+            for (uint32_t displacement = 0; displacement < 4 * slot_count && !is_placed && !bucket.empty(); ++displacement) {
+                is_placed = true;
+                for (size_t i = 0; i < bucket.size() && is_placed; ++i) {
+                    placed[i] = SlotIndex(hashes[bucket[i]], displacement, slot_count - 1);
+                    is_placed = !occupied[placed[i]] && std::find(placed.begin(), placed.begin() + i, placed[i]) == placed.begin() + i;
+                }
+                if (is_placed) {
+                    for (size_t i = 0; i < bucket.size(); ++i) {
+                        occupied[placed[i]] = true;
+                    }
+                    displacements_[bucket_order[bucket_pos]] = displacement;
+                }
+            }
+            is_placed = is_placed || bucket.empty();
+        }
+        if (is_placed) {
+            slots_.assign(slot_count, Slot());
+            break;
+        }
+    }
+    for (size_t i = 0; i < strings.size(); ++i) {
+        const uint32_t displacement = displacements_[(hashes[i] >> 32) % displacements_.size()];
+        slots_[SlotIndex(hashes[i], displacement, slots_.size() - 1)] = { static_cast<uint32_t>(chars_.size()), static_cast<uint32_t>(strings[i].size()) };
+        chars_ += strings[i];
+    }
+}
+
+bool PerfectHashSet::Contains(std::string_view str) const {
+    if (slots_.empty() || str.empty()) {
+        return false;
+    }
+    const uint64_t hash = Hash(str, seed_);
+    const uint32_t displacement = displacements_[(hash >> 32) % displacements_.size()];
+    const Slot& slot = slots_[SlotIndex(hash, displacement, slots_.size() - 1)];
+    return slot.size == str.size() && std::memcmp(chars_.data() + slot.offset, str.data(), str.size()) == 0;
+}
+
+size_t PerfectHashSet::Size() const {
+    return size_;
+}
+
+uint64_t PerfectHashSet::Hash(std::string_view str, uint64_t seed) {
+    // FNV-1a, the seed picks the offset basis
+    uint64_t hash = 0xcbf29ce484222325ull ^ (seed * 0x9e3779b97f4a7c15ull);
+    for (const char c : str) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+size_t PerfectHashSet::SlotIndex(uint64_t hash, uint32_t displacement, size_t slot_mask) {
+    // splitmix64 finalizer
+    uint64_t mixed = hash + displacement * 0x9e3779b97f4a7c15ull;
+    mixed = (mixed ^ (mixed >> 30)) * 0xbf58476d1ce4e5b9ull;
+    mixed = (mixed ^ (mixed >> 27)) * 0x94d049bb133111ebull;
+    return static_cast<size_t>(mixed ^ (mixed >> 31)) & slot_mask;
+}
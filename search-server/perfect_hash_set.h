@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Immutable set of non-empty strings laid out with hash and displace: every string gets a slot of its own,
+// so a lookup hashes once and compares with at most one stored string. Strings whose hashes collide are
+// hashed again with another seed; std::runtime_error if no seed within MAX_SEED_COUNT separates them.
+class PerfectHashSet {
+public:
+    static constexpr uint32_t MAX_SEED_COUNT = 64;
+
+    PerfectHashSet() = default;
+    explicit PerfectHashSet(std::vector<std::string_view> strings);
+
+    bool Contains(std::string_view str) const;
+    size_t Size() const;
+
+private:
+    struct Slot {
+        uint32_t offset = 0;
+        uint32_t size = 0;
+    };
+
+    std::string chars_;
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> displacements_;
+    size_t size_ = 0;
+    uint64_t seed_ = 0;
+
+    static uint64_t Hash(std::string_view str, uint64_t seed);
+    static size_t SlotIndex(uint64_t hash, uint32_t displacement, size_t slot_mask);
+};
@@ -0,0 +1,74 @@
+#include "posting_codec.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define POSTING_CODEC_SSE2
+#endif
+
+int BitWidth(uint32_t max_value) {
+    int width = 0;
+    while (max_value != 0) {
+        ++width;
+        max_value >>= 1;
+    }
+    return width;
+}
+
+void PackBits(const uint32_t* values, size_t count, int bit_width, std::vector<uint8_t>& out) {
+    if (bit_width == 0) {
+        return;
+    }
+    uint64_t buffer = 0;
+    int buffered_bits = 0;
+    for (size_t i = 0; i < count; ++i) {
+        buffer |= static_cast<uint64_t>(values[i]) << buffered_bits;
+        buffered_bits += bit_width;
+        while (buffered_bits >= 8) {
+            out.push_back(static_cast<uint8_t>(buffer));
+            buffer >>= 8;
+            buffered_bits -= 8;
+        }
+    }
+    if (buffered_bits > 0) {
+        out.push_back(static_cast<uint8_t>(buffer));
+    }
+}
+
+const uint8_t* UnpackBits(const uint8_t* in, size_t count, int bit_width, uint32_t* values) {
+    if (bit_width == 0) {
+        std::memset(values, 0, count * sizeof(uint32_t));
+        return in;
+    }
+    const uint64_t mask = (uint64_t{ 1 } << bit_width) - 1;
+    size_t bit_pos = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t word;
+        std::memcpy(&word, in + bit_pos / 8, sizeof(word));
+        values[i] = static_cast<uint32_t>((word >> (bit_pos % 8)) & mask);
+        bit_pos += bit_width;
+    }
+    return in + (bit_pos + 7) / 8;
+}
+
+void PrefixSum(uint32_t* values, size_t count, uint32_t base) {
+    size_t i = 0;
+#ifdef POSTING_CODEC_SSE2
+    __m128i carry = _mm_set1_epi32(static_cast<int>(base));
+    for (; i + 4 <= count; i += 4) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, carry);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), x);
+        carry = _mm_shuffle_epi32(x, 0xFF);
+    }
+    if (i > 0) {
+        base = values[i - 1];
+    }
+#endif
+    for (; i < count; ++i) {
+        base += values[i];
+        values[i] = base;
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Fixed-width bit packing of a block of unsigned values (frame of reference without exceptions)
+
+// Number of bits needed to store max_value
+int BitWidth(uint32_t max_value);
+
+// Appends count values of bit_width bits each; the output is padded to whole bytes
+void PackBits(const uint32_t* values, size_t count, int bit_width, std::vector<uint8_t>& out);
+
+// Reads count values written by PackBits and returns the position right after them.
+// The input must stay readable for 8 bytes past the packed values.
+const uint8_t* UnpackBits(const uint8_t* in, size_t count, int bit_width, uint32_t* values);
+
+// In-place inclusive prefix sum starting from base, vectorized with SSE2 where available
+void PrefixSum(uint32_t* values, size_t count, uint32_t base);
@@ -0,0 +1,506 @@
+#include "posting_list.h"
+#include "posting_codec.h"
+#include "snapshot.h"
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+void PostingList::Add(int document_id, double term_freq) {
+    AddPosting(document_id, term_freq);
+    if (bitmap_) {
+        bitmap_->Add(document_id);
+    } else if (Size() >= BITMAP_MIN_SIZE) {
+        BuildBitmap();
+    }
+}
+
+bool PostingList::Remove(int document_id) {
+    if (!RemovePosting(document_id)) {
+        return false;
+    }
+    if (bitmap_) {
+        bitmap_->Remove(document_id);
+    }
+    return true;
+}
+
+void PostingList::AddPosting(int document_id, double term_freq) {
+    max_freq_ = std::max(max_freq_, term_freq);
+    if (IsCompressed()) {
+        // a compressed main part is immutable; a re-added document shadows its tombstone from the delta
+        AddToDelta(document_id, term_freq);
+        return;
+    }
+    if (ids_.empty() || ids_.back() < document_id) {
+        ids_.push_back(document_id);
+        freqs_.push_back(term_freq);
+        RaiseBlockMax(ids_.size() - 1, term_freq);
+        return;
+    }
+    const auto main_it = std::lower_bound(ids_.begin(), ids_.end(), document_id);
+    if (main_it != ids_.end() && *main_it == document_id) {
+        // the document was removed earlier and is added again under the same id
+        freqs_[main_it - ids_.begin()] = term_freq;
+        RaiseBlockMax(main_it - ids_.begin(), term_freq);
+        --removed_count_;
+        return;
+    }
+    AddToDelta(document_id, term_freq);
+}
+
+bool PostingList::RemovePosting(int document_id) {
+    if (IsCompressed()) {
+        if (MainContains(document_id)) {
+            removed_ids_.insert(std::lower_bound(removed_ids_.begin(), removed_ids_.end(), document_id), document_id);
+            ++removed_count_;
+            return true;
+        }
+    } else {
+        const auto main_it = std::lower_bound(ids_.begin(), ids_.end(), document_id);
+        if (main_it != ids_.end() && *main_it == document_id && freqs_[main_it - ids_.begin()] != 0.0) {
+            freqs_[main_it - ids_.begin()] = 0.0;
+            ++removed_count_;
+            return true;
+        }
+    }
+    const auto delta_it = std::lower_bound(delta_ids_.begin(), delta_ids_.end(), document_id);
+    if (delta_it == delta_ids_.end() || *delta_it != document_id) {
+        return false;
+    }
+    delta_freqs_.erase(delta_freqs_.begin() + (delta_it - delta_ids_.begin()));
+    delta_ids_.erase(delta_it);
+    return true;
+}
+
+bool PostingList::Contains(int document_id) const {
+    if (bitmap_) {
+        return bitmap_->Contains(document_id);
+    }
+    return MainContains(document_id) || std::binary_search(delta_ids_.begin(), delta_ids_.end(), document_id);
+}
+
+size_t PostingList::Size() const {
+    return MainSize() - removed_count_ + delta_ids_.size();
+}
+
+double PostingList::MaxTermFreq() const {
+    return max_freq_;
+}
+
+bool PostingList::IsCompact() const {
+    return removed_count_ == 0 && delta_ids_.empty();
+}
+
+PostingFormat PostingList::Format() const {
+    return IsCompressed() ? PostingFormat::COMPRESSED : PostingFormat::PLAIN;
+}
+
+const DocIdBitmap* PostingList::Bitmap() const {
+    return bitmap_.get();
+}
+
+size_t PostingList::MemoryUsage() const {
+    return ids_.capacity() * sizeof(int) + freqs_.capacity() * sizeof(double)
+        + block_storage_.capacity() * sizeof(CompressedBlock) + data_storage_.capacity() + removed_ids_.capacity() * sizeof(int)
+        + delta_ids_.capacity() * sizeof(int) + delta_freqs_.capacity() * sizeof(double)
+        + block_max_freqs_.capacity() * sizeof(double) + summed_freqs_.capacity() * sizeof(std::pair<uint64_t, double>)
+        + (bitmap_ ? sizeof(DocIdBitmap) + bitmap_->MemoryUsage() : 0);
+}
+
+void PostingList::Compact() {
+    if (!IsCompressed() && IsCompact()) {
+        return;
+    }
+    std::vector<int> ids;
+    std::vector<double> freqs;
+    ids.reserve(Size());
+    freqs.reserve(Size());
+    ForEach([&ids, &freqs](int document_id, double term_freq) {
+        ids.push_back(document_id);
+        freqs.push_back(term_freq);
+    });
+    // the docids stay the same, so does the bitmap
+    auto bitmap = std::move(bitmap_);
+    *this = PostingList();
+    ids_ = std::move(ids);
+    freqs_ = std::move(freqs);
+    for (size_t pos = 0; pos < freqs_.size(); ++pos) {
+        RaiseBlockMax(pos, freqs_[pos]);
+        max_freq_ = std::max(max_freq_, freqs_[pos]);
+    }
+    bitmap_ = std::move(bitmap);
+}
+
+void PostingList::Save(SnapshotWriter& writer) const {
+    writer.WriteArray<int>(ids_);
+    writer.WriteArray<double>(freqs_);
+    writer.WriteArray<CompressedBlock>(blocks_);
+    writer.WriteArray<uint8_t>(data_);
+    writer.Write(static_cast<uint64_t>(compressed_count_));
+    writer.WriteArray<int>(removed_ids_);
+    writer.WriteArray<int>(delta_ids_);
+    writer.WriteArray<double>(delta_freqs_);
+    writer.WriteArray<double>(block_max_freqs_);
+    writer.Write(max_freq_);
+    writer.Write(static_cast<uint64_t>(removed_count_));
+}
+
+void PostingList::Load(SnapshotReader& reader) {
+    *this = PostingList();
+    const auto ids = reader.ReadArray<int>();
+    const auto freqs = reader.ReadArray<double>();
+    ids_.assign(ids.begin(), ids.end());
+    freqs_.assign(freqs.begin(), freqs.end());
+    blocks_ = reader.ReadArray<CompressedBlock>();
+    data_ = reader.ReadArray<uint8_t>();
+    compressed_count_ = static_cast<size_t>(reader.Read<uint64_t>());
+    const auto removed_ids = reader.ReadArray<int>();
+    const auto delta_ids = reader.ReadArray<int>();
+    const auto delta_freqs = reader.ReadArray<double>();
+    const auto block_max_freqs = reader.ReadArray<double>();
+    removed_ids_.assign(removed_ids.begin(), removed_ids.end());
+    delta_ids_.assign(delta_ids.begin(), delta_ids.end());
+    delta_freqs_.assign(delta_freqs.begin(), delta_freqs.end());
+    block_max_freqs_.assign(block_max_freqs.begin(), block_max_freqs.end());
+    max_freq_ = reader.Read<double>();
+    removed_count_ = static_cast<size_t>(reader.Read<uint64_t>());
+    Validate();
+    BuildSummedFreqs();
+    BuildBitmap();
+}
+
+void PostingList::Validate() const {
+    const auto is_ascending = [](std::span<const int> ids) {
+        return (ids.empty() || ids.front() >= 0) && std::adjacent_find(ids.begin(), ids.end(), [](int lhs, int rhs) {
+            return lhs >= rhs;
+        }) == ids.end();
+    };
+    bool is_valid = freqs_.size() == ids_.size() && delta_freqs_.size() == delta_ids_.size() && is_ascending(ids_)
+        && is_ascending(removed_ids_) && is_ascending(delta_ids_) && block_max_freqs_.size() == BlockCount();
+    if (!IsCompressed()) {
+        is_valid = is_valid && data_.empty() && compressed_count_ == 0 && removed_ids_.empty()
+            && removed_count_ == static_cast<size_t>(std::count(freqs_.begin(), freqs_.end(), 0.0));
+    } else {
+        // blocks follow each other in docid order and in the data, which ends with the padding UnpackBits reads
+        is_valid = is_valid && ids_.empty() && removed_count_ == removed_ids_.size();
+        const auto packed_size = [](size_t count, int bit_width) {
+            return (count * bit_width + 7) / 8;
+        };
+        std::array<uint32_t, BLOCK_SIZE> gaps;
+        std::array<uint32_t, BLOCK_SIZE> counts;
+        std::array<uint32_t, BLOCK_SIZE> lengths;
+        size_t data_end = 0;
+        size_t posting_count = 0;
+        int64_t previous_last_id = -1;
+        for (const CompressedBlock& info : blocks_) {
+            is_valid = is_valid && info.size >= 1 && info.size <= BLOCK_SIZE && info.gap_bits <= 32 && info.count_bits <= 32
+                && info.length_bits <= 32 && info.offset == data_end && info.first_id > previous_last_id && info.first_id <= info.last_id;
+            if (!is_valid) {
+                break;
+            }
+            data_end += packed_size(info.size, info.gap_bits) + packed_size(info.size, info.count_bits) + packed_size(info.size, info.length_bits);
+            if (data_.size() < sizeof(uint64_t) || data_end > data_.size() - sizeof(uint64_t)) {
+                is_valid = false;
+                break;
+            }
+            const uint8_t* in = UnpackBits(data_.data() + info.offset, info.size, info.gap_bits, gaps.data());
+            in = UnpackBits(in, info.size, info.count_bits, counts.data());
+            UnpackBits(in, info.size, info.length_bits, lengths.data());
+            uint64_t document_id = static_cast<uint64_t>(info.first_id);
+            is_valid = gaps[0] == 0;
+            for (size_t i = 0; i < info.size; ++i) {
+                document_id += gaps[i];
+                // term counts are stored minus one and never exceed the document length
+                is_valid = is_valid && (i == 0 || gaps[i] > 0) && lengths[i] <= INT_MAX && counts[i] < lengths[i];
+            }
+            is_valid = is_valid && document_id == static_cast<uint64_t>(info.last_id);
+            posting_count += info.size;
+            previous_last_id = info.last_id;
+        }
+        is_valid = is_valid && posting_count == compressed_count_;
+        std::array<int, BLOCK_SIZE> ids;
+        is_valid = is_valid && std::all_of(removed_ids_.begin(), removed_ids_.end(), [&](int document_id) {
+            const auto block_it = std::lower_bound(blocks_.begin(), blocks_.end(), document_id, [](const CompressedBlock& block, int id) {
+                return block.last_id < id;
+            });
+            if (block_it == blocks_.end() || block_it->first_id > document_id) {
+                return false;
+            }
+            DecodeBlockIds(block_it - blocks_.begin(), ids.data());
+            return std::binary_search(ids.begin(), ids.begin() + block_it->size, document_id);
+        });
+    }
+    // the delta only holds documents the main part has no live posting for
+    is_valid = is_valid && removed_count_ <= MainSize() && std::none_of(delta_ids_.begin(), delta_ids_.end(), [this](int document_id) {
+        return MainContains(document_id);
+    });
+    if (!is_valid) {
+        throw std::runtime_error(std::string("Corrupted snapshot"));
+    }
+}
+
+void PostingList::BuildBitmap() {
+    bitmap_.reset();
+    if (Size() < BITMAP_MIN_SIZE) {
+        return;
+    }
+    auto bitmap = std::make_unique<DocIdBitmap>();
+    ForEach([&bitmap](int document_id, double) {
+        bitmap->Add(document_id);
+    });
+    bitmap_ = std::move(bitmap);
+}
+
+bool PostingList::IsCompressed() const {
+    return !blocks_.empty();
+}
+
+size_t PostingList::MainSize() const {
+    return IsCompressed() ? compressed_count_ : ids_.size();
+}
+
+size_t PostingList::BlockCount() const {
+    return IsCompressed() ? blocks_.size() : (ids_.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+int PostingList::BlockLastId(size_t block) const {
+    if (IsCompressed()) {
+        return blocks_[block].last_id;
+    }
+    return ids_[std::min(ids_.size(), (block + 1) * BLOCK_SIZE) - 1];
+}
+
+bool PostingList::MainContains(int document_id) const {
+    if (!IsCompressed()) {
+        const auto main_it = std::lower_bound(ids_.begin(), ids_.end(), document_id);
+        return main_it != ids_.end() && *main_it == document_id && freqs_[main_it - ids_.begin()] != 0.0;
+    }
+    const auto block_it = std::lower_bound(blocks_.begin(), blocks_.end(), document_id, [](const CompressedBlock& block, int id) {
+        return block.last_id < id;
+    });
+    if (block_it == blocks_.end() || block_it->first_id > document_id) {
+        return false;
+    }
+    std::array<int, BLOCK_SIZE> ids;
+    DecodeBlockIds(block_it - blocks_.begin(), ids.data());
+    return std::binary_search(ids.begin(), ids.begin() + block_it->size, document_id)
+        && !std::binary_search(removed_ids_.begin(), removed_ids_.end(), document_id);
+}
+
+void PostingList::AddToDelta(int document_id, double term_freq) {
+    const auto delta_it = std::lower_bound(delta_ids_.begin(), delta_ids_.end(), document_id);
+    const auto pos = delta_it - delta_ids_.begin();
+    delta_ids_.insert(delta_it, document_id);
+    delta_freqs_.insert(delta_freqs_.begin() + pos, term_freq);
+}
+
+void PostingList::RaiseBlockMax(size_t pos, double term_freq) {
+    const size_t block = pos / BLOCK_SIZE;
+    if (block == block_max_freqs_.size()) {
+        block_max_freqs_.push_back(term_freq);
+    } else {
+        block_max_freqs_[block] = std::max(block_max_freqs_[block], term_freq);
+    }
+}
+
+void PostingList::DecodeBlockIds(size_t block, int* ids) const {
+    const CompressedBlock& info = blocks_[block];
+    uint32_t* values = reinterpret_cast<uint32_t*>(ids);
+    UnpackBits(data_.data() + info.offset, info.size, info.gap_bits, values);
+    PrefixSum(values, info.size, static_cast<uint32_t>(info.first_id));
+}
+
+void PostingList::DecodeBlock(size_t block, int* ids, double* freqs) const {
+    const CompressedBlock& info = blocks_[block];
+    uint32_t* values = reinterpret_cast<uint32_t*>(ids);
+    const uint8_t* in = UnpackBits(data_.data() + info.offset, info.size, info.gap_bits, values);
+    PrefixSum(values, info.size, static_cast<uint32_t>(info.first_id));
+    std::array<uint32_t, BLOCK_SIZE> counts;
+    std::array<uint32_t, BLOCK_SIZE> lengths;
+    in = UnpackBits(in, info.size, info.count_bits, counts.data());
+    UnpackBits(in, info.size, info.length_bits, lengths.data());
+    for (size_t i = 0; i < info.size; ++i) {
+        freqs[i] = TermFreqFromCount(counts[i] + 1, lengths[i]);
+    }
+    auto removed_it = std::lower_bound(removed_ids_.begin(), removed_ids_.end(), info.first_id);
+    for (size_t i = 0; i < info.size && removed_it != removed_ids_.end() && *removed_it <= info.last_id; ++i) {
+        while (removed_it != removed_ids_.end() && *removed_it < ids[i]) {
+            ++removed_it;
+        }
+        if (removed_it != removed_ids_.end() && *removed_it == ids[i]) {
+            freqs[i] = 0.0;
+        }
+    }
+}
+
+void PostingList::Encode(const std::vector<int>& ids, const std::vector<uint32_t>& counts, const std::vector<uint32_t>& lengths) {
+    auto bitmap = std::move(bitmap_);
+    *this = PostingList();
+    if (ids.empty()) {
+        return;
+    }
+    std::array<uint32_t, BLOCK_SIZE> gaps;
+    std::array<uint32_t, BLOCK_SIZE> count_values;
+    for (size_t begin = 0; begin < ids.size(); begin += BLOCK_SIZE) {
+        const size_t size = std::min(BLOCK_SIZE, ids.size() - begin);
+        CompressedBlock block{ ids[begin], ids[begin + size - 1], static_cast<uint32_t>(data_storage_.size()), static_cast<uint8_t>(size), 0, 0, 0 };
+        uint32_t max_gap = 0;
+        uint32_t max_count = 0;
+        uint32_t max_length = 0;
+        double block_max_freq = 0.0;
+        for (size_t i = 0; i < size; ++i) {
+            gaps[i] = i == 0 ? 0 : static_cast<uint32_t>(ids[begin + i] - ids[begin + i - 1]);
+            count_values[i] = counts[begin + i] - 1;
+            max_gap = std::max(max_gap, gaps[i]);
+            max_count = std::max(max_count, count_values[i]);
+            max_length = std::max(max_length, lengths[begin + i]);
+            block_max_freq = std::max(block_max_freq, SumTermFreq(counts[begin + i], lengths[begin + i]));
+        }
+        block.gap_bits = static_cast<uint8_t>(BitWidth(max_gap));
+        block.count_bits = static_cast<uint8_t>(BitWidth(max_count));
+        block.length_bits = static_cast<uint8_t>(BitWidth(max_length));
+        PackBits(gaps.data(), size, block.gap_bits, data_storage_);
+        PackBits(count_values.data(), size, block.count_bits, data_storage_);
+        PackBits(lengths.data() + begin, size, block.length_bits, data_storage_);
+        block_storage_.push_back(block);
+        block_max_freqs_.push_back(block_max_freq);
+        max_freq_ = std::max(max_freq_, block_max_freq);
+    }
+    // UnpackBits reads whole 64-bit words
+    data_storage_.resize(data_storage_.size() + sizeof(uint64_t), 0);
+    data_storage_.shrink_to_fit();
+    block_storage_.shrink_to_fit();
+    block_max_freqs_.shrink_to_fit();
+    blocks_ = block_storage_;
+    data_ = data_storage_;
+    compressed_count_ = ids.size();
+    BuildSummedFreqs();
+    bitmap_ = std::move(bitmap);
+}
+
+void PostingList::BuildSummedFreqs() {
+    summed_freqs_.clear();
+    std::vector<uint64_t> keys;
+    std::array<uint32_t, BLOCK_SIZE> gaps;
+    std::array<uint32_t, BLOCK_SIZE> counts;
+    std::array<uint32_t, BLOCK_SIZE> lengths;
+    for (const CompressedBlock& info : blocks_) {
+        const uint8_t* in = UnpackBits(data_.data() + info.offset, info.size, info.gap_bits, gaps.data());
+        in = UnpackBits(in, info.size, info.count_bits, counts.data());
+        UnpackBits(in, info.size, info.length_bits, lengths.data());
+        for (size_t i = 0; i < info.size; ++i) {
+            if (counts[i] + 1 > 3) {
+                keys.push_back(uint64_t{ lengths[i] } << 32 | (counts[i] + 1));
+            }
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    for (const uint64_t key : keys) {
+        const uint32_t count = static_cast<uint32_t>(key);
+        const uint32_t length = static_cast<uint32_t>(key >> 32);
+        const double term_freq = SumTermFreq(count, length);
+        if (term_freq != count * (1.0 / length)) {
+            summed_freqs_.emplace_back(key, term_freq);
+        }
+    }
+    summed_freqs_.shrink_to_fit();
+}
+
+double PostingList::SumTermFreq(uint32_t count, uint32_t length) {
+    // the same summation AddDocument uses, so the frequency comes back bit-identical
+    const double inv_word_count = 1.0 / length;
+    double term_freq = 0.0;
+    for (uint32_t i = 0; i < count; ++i) {
+        term_freq += inv_word_count;
+    }
+    return term_freq;
+}
+
+double PostingList::TermFreqFromCount(uint32_t count, uint32_t length) const {
+    // up to three additions of 1 / length round exactly like the multiplication
+    const double term_freq = count * (1.0 / length);
+    if (count <= 3 || summed_freqs_.empty()) {
+        return term_freq;
+    }
+    const uint64_t key = uint64_t{ length } << 32 | count;
+    const auto it = std::lower_bound(summed_freqs_.begin(), summed_freqs_.end(), key, [](const std::pair<uint64_t, double>& entry, uint64_t key) {
+        return entry.first < key;
+    });
+    return it != summed_freqs_.end() && it->first == key ? it->second : term_freq;
+}
+
+PostingList::Cursor::Cursor(const PostingList& postings, std::pmr::memory_resource* resource)
+    : postings_(&postings)
+    , resource_(resource) {
+    if (postings.IsCompressed()) {
+        buffer_ = new (resource_->allocate(sizeof(Buffer), alignof(Buffer))) Buffer;
+    }
+    LoadBlock(0);
+    SkipRemoved();
+}
+
+PostingList::Cursor::Cursor(Cursor&& other) noexcept
+    : postings_(other.postings_)
+    , block_(other.block_)
+    , block_pos_(other.block_pos_)
+    , block_size_(other.block_size_)
+    , block_ids_(other.block_ids_)
+    , block_freqs_(other.block_freqs_)
+    , resource_(other.resource_)
+    , buffer_(std::exchange(other.buffer_, nullptr))
+    , delta_pos_(other.delta_pos_) {
+}
+
+PostingList::Cursor::~Cursor() {
+    if (buffer_ != nullptr) {
+        resource_->deallocate(buffer_, sizeof(Buffer), alignof(Buffer));
+    }
+}
+
+void PostingList::Cursor::LoadBlock(size_t block) {
+    block_ = block;
+    block_pos_ = 0;
+    if (block >= postings_->BlockCount()) {
+        block_size_ = 0;
+        return;
+    }
+    if (buffer_) {
+        postings_->DecodeBlock(block, buffer_->ids.data(), buffer_->freqs.data());
+        block_size_ = postings_->blocks_[block].size;
+        block_ids_ = buffer_->ids.data();
+        block_freqs_ = buffer_->freqs.data();
+    } else {
+        const size_t begin = block * BLOCK_SIZE;
+        block_size_ = std::min(BLOCK_SIZE, postings_->ids_.size() - begin);
+        block_ids_ = postings_->ids_.data() + begin;
+        block_freqs_ = postings_->freqs_.data() + begin;
+    }
+}
+
+void PostingList::Cursor::SkipTo(int document_id) {
+    if (!IsMainEnd() && block_ids_[block_pos_] < document_id) {
+        if (postings_->BlockLastId(block_) < document_id) {
+            size_t low = block_ + 1;
+            size_t high = postings_->BlockCount();
+            while (low < high) {
+                const size_t middle = low + (high - low) / 2;
+                if (postings_->BlockLastId(middle) < document_id) {
+                    low = middle + 1;
+                } else {
+                    high = middle;
+                }
+            }
+            LoadBlock(low);
+        }
+        if (!IsMainEnd()) {
+            block_pos_ = std::lower_bound(block_ids_ + block_pos_, block_ids_ + block_size_, document_id) - block_ids_;
+            SkipRemoved();
+        }
+    }
+    const auto& delta_ids = postings_->delta_ids_;
+    if (delta_pos_ < delta_ids.size() && delta_ids[delta_pos_] < document_id) {
+        delta_pos_ = std::lower_bound(delta_ids.begin() + delta_pos_, delta_ids.end(), document_id) - delta_ids.begin();
+    }
+}
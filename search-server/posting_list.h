@@ -0,0 +1,257 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <utility>
+#include <vector>
+#include "docid_bitmap.h"
+
+class SnapshotReader;
+class SnapshotWriter;
+
+enum class PostingFormat {
+    PLAIN,
+    COMPRESSED,
+};
+
+// Docid-sorted postings of one word. The main part is either plain parallel arrays (ids and term
+// frequencies) or compressed blocks of BLOCK_SIZE postings: bit-packed docid gaps plus the term
+// frequency stored exactly as a word count over the document word count.
+// Out-of-order additions go to a small sorted delta, removals zero the frequency in place (plain) or
+// are recorded as tombstones (compressed); Compact() and Compress() fold both back into the main part.
+// Maximum term frequencies are kept per list and per block as score upper bounds;
+// removals leave them stale, which keeps them valid bounds until the next re-encoding.
+// A compressed main part read from a snapshot is used in place, the snapshot memory must outlive the list.
+// Lists of at least BITMAP_MIN_SIZE postings also keep their docids in a bitmap for constant-time membership.
+class PostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+    static constexpr size_t BITMAP_MIN_SIZE = 4096;
+
+    PostingList() = default;
+    PostingList(const PostingList&) = delete;
+    PostingList& operator=(const PostingList&) = delete;
+    PostingList(PostingList&&) = default;
+    PostingList& operator=(PostingList&&) = default;
+
+    void Add(int document_id, double term_freq);
+    bool Remove(int document_id);
+    bool Contains(int document_id) const;
+
+    size_t Size() const;
+    double MaxTermFreq() const;
+    bool IsCompact() const;
+    PostingFormat Format() const;
+    // Docids of the live postings, nullptr while the list has stayed below BITMAP_MIN_SIZE
+    const DocIdBitmap* Bitmap() const;
+    // Bytes allocated by the list, block metadata and delta included
+    size_t MemoryUsage() const;
+
+    // Rebuilds the main part as plain arrays
+    void Compact();
+    // Rebuilds the main part compressed. word_count(document_id) must return the number of words the
+    // document's term frequencies were computed from; lists that don't fit that model stay plain.
+    template <typename WordCount>
+    void Compress(WordCount word_count);
+
+    // Calls func(document_id, term_freq) for every live posting in ascending docid order
+    template <typename Func>
+    void ForEach(Func func) const;
+
+    void Save(SnapshotWriter& writer) const;
+    void Load(SnapshotReader& reader);
+
+    // Forward iterator over live postings in ascending docid order, merging the delta on the fly.
+    // Compressed blocks are decoded one at a time into a buffer the cursor takes from resource.
+    class Cursor {
+    public:
+        explicit Cursor(const PostingList& postings, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+        Cursor(const Cursor&) = delete;
+        Cursor& operator=(const Cursor&) = delete;
+        Cursor(Cursor&& other) noexcept;
+        Cursor& operator=(Cursor&&) = delete;
+        ~Cursor();
+
+        bool IsEnd() const;
+        int DocumentId() const;
+        double TermFreq() const;
+        void Next();
+        // Moves to the first posting with docid >= document_id
+        void SkipTo(int document_id);
+
+        // Upper bound of term frequencies up to and including BlockLastDocumentId()
+        double BlockMaxTermFreq() const;
+        int BlockLastDocumentId() const;
+
+    private:
+        struct Buffer {
+            std::array<int, BLOCK_SIZE> ids;
+            std::array<double, BLOCK_SIZE> freqs;
+        };
+
+        const PostingList* postings_;
+        size_t block_ = 0;
+        size_t block_pos_ = 0;
+        size_t block_size_ = 0;
+        const int* block_ids_ = nullptr;
+        const double* block_freqs_ = nullptr;
+        std::pmr::memory_resource* resource_;
+        Buffer* buffer_ = nullptr;
+        size_t delta_pos_ = 0;
+
+        bool IsMainEnd() const;
+        bool IsMainCurrent() const;
+        void LoadBlock(size_t block);
+        void NextInMain();
+        void SkipRemoved();
+    };
+
+private:
+    struct CompressedBlock {
+        int first_id;
+        int last_id;
+        uint32_t offset;
+        uint8_t size;
+        uint8_t gap_bits;
+        uint8_t count_bits;
+        uint8_t length_bits;
+    };
+
+    std::vector<int> ids_;
+    std::vector<double> freqs_;
+    // compressed main part, backed by the storage vectors or by a snapshot
+    std::span<const CompressedBlock> blocks_;
+    std::span<const uint8_t> data_;
+    std::vector<CompressedBlock> block_storage_;
+    std::vector<uint8_t> data_storage_;
+    std::vector<int> removed_ids_;
+    size_t compressed_count_ = 0;
+    std::vector<int> delta_ids_;
+    std::vector<double> delta_freqs_;
+    std::vector<double> block_max_freqs_;
+    // (length << 32 | count, term frequency) of the compressed postings whose summed frequency rounds
+    // differently from count * (1.0 / length); sorted by key
+    std::vector<std::pair<uint64_t, double>> summed_freqs_;
+    double max_freq_ = 0.0;
+    size_t removed_count_ = 0;
+    std::unique_ptr<DocIdBitmap> bitmap_;
+
+    void AddPosting(int document_id, double term_freq);
+    bool RemovePosting(int document_id);
+    // Builds the bitmap from scratch if the list is large enough
+    void BuildBitmap();
+    bool IsCompressed() const;
+    size_t MainSize() const;
+    size_t BlockCount() const;
+    int BlockLastId(size_t block) const;
+    bool MainContains(int document_id) const;
+    void AddToDelta(int document_id, double term_freq);
+    void RaiseBlockMax(size_t pos, double term_freq);
+    void DecodeBlockIds(size_t block, int* ids) const;
+    // Decodes a compressed block, zeroing the frequencies of removed postings
+    void DecodeBlock(size_t block, int* ids, double* freqs) const;
+    // Replaces the main part with the given postings, which must be the live postings of the list
+    void Encode(const std::vector<int>& ids, const std::vector<uint32_t>& counts, const std::vector<uint32_t>& lengths);
+    // Fills summed_freqs_ from the compressed blocks
+    void BuildSummedFreqs();
+    // Checks a loaded list before anything decodes it; throws std::runtime_error if it is inconsistent
+    void Validate() const;
+
+    // The term frequency AddDocument computes, by the same summation of count times 1 / length
+    static double SumTermFreq(uint32_t count, uint32_t length);
+    // SumTermFreq in one multiplication, plus a lookup for the few postings where that rounds differently
+    double TermFreqFromCount(uint32_t count, uint32_t length) const;
+};
+
+inline bool PostingList::Cursor::IsMainEnd() const {
+    return block_size_ == 0;
+}
+
+inline bool PostingList::Cursor::IsEnd() const {
+    return IsMainEnd() && delta_pos_ == postings_->delta_ids_.size();
+}
+
+inline bool PostingList::Cursor::IsMainCurrent() const {
+    return !IsMainEnd() && (delta_pos_ == postings_->delta_ids_.size()
+        || block_ids_[block_pos_] < postings_->delta_ids_[delta_pos_]);
+}
+
+inline int PostingList::Cursor::DocumentId() const {
+    return IsMainCurrent() ? block_ids_[block_pos_] : postings_->delta_ids_[delta_pos_];
+}
+
+inline double PostingList::Cursor::TermFreq() const {
+    return IsMainCurrent() ? block_freqs_[block_pos_] : postings_->delta_freqs_[delta_pos_];
+}
+
+inline void PostingList::Cursor::NextInMain() {
+    if (++block_pos_ == block_size_) {
+        LoadBlock(block_ + 1);
+    }
+}
+
+inline void PostingList::Cursor::Next() {
+    if (IsMainCurrent()) {
+        NextInMain();
+        SkipRemoved();
+    } else {
+        ++delta_pos_;
+    }
+}
+
+inline void PostingList::Cursor::SkipRemoved() {
+    while (!IsMainEnd() && block_freqs_[block_pos_] == 0.0) {
+        NextInMain();
+    }
+}
+
+inline double PostingList::Cursor::BlockMaxTermFreq() const {
+    if (!postings_->delta_ids_.empty() || IsMainEnd()) {
+        return postings_->max_freq_;
+    }
+    return postings_->block_max_freqs_[block_];
+}
+
+inline int PostingList::Cursor::BlockLastDocumentId() const {
+    if (!postings_->delta_ids_.empty() || IsMainEnd()) {
+        return INT_MAX;
+    }
+    return postings_->BlockLastId(block_);
+}
+
+template <typename WordCount>
+void PostingList::Compress(WordCount word_count) {
+    std::vector<int> ids;
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> lengths;
+    ids.reserve(Size());
+    counts.reserve(Size());
+    lengths.reserve(Size());
+    bool is_exact = true;
+    ForEach([&](int document_id, double term_freq) {
+        const uint32_t length = static_cast<uint32_t>(word_count(document_id));
+        const uint32_t count = static_cast<uint32_t>(std::lround(term_freq * length));
+        is_exact = is_exact && count > 0 && SumTermFreq(count, length) == term_freq;
+        ids.push_back(document_id);
+        counts.push_back(count);
+        lengths.push_back(length);
+    });
+    if (is_exact) {
+        Encode(ids, counts, lengths);
+    } else {
+        Compact();
+    }
+}
+
+template <typename Func>
+void PostingList::ForEach(Func func) const {
+    for (Cursor cursor(*this); !cursor.IsEnd(); cursor.Next()) {
+        func(cursor.DocumentId(), cursor.TermFreq());
+    }
+}
@@ -6,19 +6,24 @@
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries) {
-    std::vector<std::vector<Document>> result(queries.size());
-    std::transform(std::execution::par, queries.begin(), queries.end(), result.begin(), [&search_server](const std::string& query) {
-        return search_server.FindTopDocuments(query);
-    });
-    return result;
+    return search_server.FindTopDocumentsBatch(queries);
 }
 
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries) {
-    std::vector<Document> result;
-    for (std::vector<Document> temp : ProcessQueries(search_server, queries)) {
-        result.insert(result.end(), temp.begin(), temp.end());
-    }
+    const auto results = ProcessQueries(search_server, queries);
+    // every query's documents are copied once, straight to their final place
+    std::vector<size_t> offsets(results.size() + 1, 0);
+    std::transform_inclusive_scan(results.begin(), results.end(), offsets.begin() + 1, std::plus<>(),
+        [](const std::vector<Document>& documents) {
+            return documents.size();
+        });
+    std::vector<Document> result(offsets.back());
+    std::vector<size_t> indexes(results.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t index) {
+        std::copy(results[index].begin(), results[index].end(), result.begin() + offsets[index]);
+    });
     return result;
-}
\ No newline at end of file
+}
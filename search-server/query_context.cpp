@@ -0,0 +1,119 @@
+#include "query_context.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+void QueryArena::Rewind() {
+    block_ = 0;
+    offset_ = 0;
+    size_t capacity = Capacity();
+    while (blocks_.size() > 1 && capacity > MAX_RETAINED_BYTES) {
+        capacity -= blocks_.back().size;
+        blocks_.pop_back();
+    }
+}
+
+size_t QueryArena::Capacity() const {
+    size_t capacity = 0;
+    for (const Block& block : blocks_) {
+        capacity += block.size;
+    }
+    return capacity;
+}
+
+void* QueryArena::do_allocate(size_t bytes, size_t alignment) {
+    for (; block_ < blocks_.size(); ++block_, offset_ = 0) {
+        const Block& block = blocks_[block_];
+        const auto address = reinterpret_cast<uintptr_t>(block.data.get()) + offset_;
+        const size_t padding = (alignment - address % alignment) % alignment;
+        if (padding + bytes <= block.size - offset_) {
+            offset_ += padding + bytes;
+            return block.data.get() + offset_ - bytes;
+        }
+    }
+    // blocks double, so a thread settles on a few of them
+    const size_t size = std::max({ bytes + alignment, INITIAL_BLOCK_SIZE, blocks_.empty() ? 0 : blocks_.back().size * 2 });
+    blocks_.push_back({ std::make_unique<std::byte[]>(size), size });
+    block_ = blocks_.size() - 1;
+    offset_ = 0;
+    return do_allocate(bytes, alignment);
+}
+
+void QueryArena::do_deallocate(void*, size_t, size_t) {
+}
+
+bool QueryArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+struct QueryScope::ThreadContext {
+    QueryArena arena;
+    size_t depth = 0;
+};
+
+QueryScope::QueryScope()
+    : context_([]() -> ThreadContext& {
+        thread_local ThreadContext context;
+        return context;
+    }()) {
+    ++context_.depth;
+}
+
+QueryScope::~QueryScope() {
+    if (--context_.depth == 0) {
+        context_.arena.Rewind();
+    }
+}
+
+QueryArena& QueryScope::Arena() const {
+    return context_.arena;
+}
+
+#ifdef SEARCH_SERVER_COUNT_ALLOCATIONS
+namespace {
+thread_local uint64_t allocation_count = 0;
+
+void* CountedAllocate(size_t size, size_t alignment) {
+    ++allocation_count;
+    size = std::max<size_t>(size, 1);
+    void* pointer = alignment <= alignof(std::max_align_t) ? std::malloc(size)
+        : std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+}
+
+void* operator new(size_t size) {
+    return CountedAllocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    return CountedAllocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+uint64_t GetThreadAllocationCount() {
+    return allocation_count;
+}
+#else
+uint64_t GetThreadAllocationCount() {
+    return 0;
+}
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Monotonic arena for the scratch state of queries. Unlike std::pmr::monotonic_buffer_resource it keeps
+// its blocks when rewound, up to MAX_RETAINED_BYTES, so once a thread has served its largest query the
+// following ones take all their memory from blocks it already owns.
+class QueryArena : public std::pmr::memory_resource {
+public:
+    static constexpr size_t INITIAL_BLOCK_SIZE = 64 * 1024;
+    static constexpr size_t MAX_RETAINED_BYTES = 4 * 1024 * 1024;
+
+    QueryArena() = default;
+    QueryArena(const QueryArena&) = delete;
+    QueryArena& operator=(const QueryArena&) = delete;
+
+    // Makes all the memory available again; nothing allocated before may be used afterwards
+    void Rewind();
+    size_t Capacity() const;
+
+private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks_;
+    size_t block_ = 0;
+    size_t offset_ = 0;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
+
+// One query on the calling thread. Every thread has its own arena, which is rewound when the outermost
+// scope of the thread ends; scopes nest because a thread waiting for the parts of a parallel query runs
+// some of them itself.
+class QueryScope {
+public:
+    QueryScope();
+    ~QueryScope();
+    QueryScope(const QueryScope&) = delete;
+    QueryScope& operator=(const QueryScope&) = delete;
+
+    QueryArena& Arena() const;
+
+private:
+    struct ThreadContext;
+
+    ThreadContext& context_;
+};
+
+// Heap allocations made by the calling thread so far. They are only counted in builds that define
+// SEARCH_SERVER_COUNT_ALLOCATIONS, which replaces the global operator new for that; 0 otherwise.
+uint64_t GetThreadAllocationCount();
@@ -1,27 +1,160 @@
 #include "remove_duplicates.h"
-#include <set>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <execution>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <numeric>
 #include <string>
-#include <map>
-#include <cstdlib>
-
-void RemoveDuplicates(SearchServer& search_server){
-    std::set <int> duplicates;
-    std::map <std::set<std::string>, int> for_duplicates;
-    for (auto id : search_server) {
-        std::set<std::string> words;
-        const auto what_ = search_server.GetWordFrequencies(id);
-        for (auto [word, fr] : what_) {
-            words.insert(word);
-        }        
-        if (for_duplicates.count(words)) {
-            duplicates.insert(std::max(id, for_duplicates.at(words)));
-        } else {
-            for_duplicates.emplace(words, id);
-        }    
-    }
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+constexpr size_t MIN_HASH_BAND_COUNT = 16;
+constexpr size_t MIN_HASH_BAND_ROWS = 4;
+constexpr size_t MIN_HASH_SIZE = MIN_HASH_BAND_COUNT * MIN_HASH_BAND_ROWS;
+
+uint64_t Mix(uint64_t value) {
+    // splitmix64 finalizer
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+}
+
+// Ids of the document's words, ascending; equal vectors mean equal word sets
+std::vector<TermId> GetTermIds(const SearchServer& search_server, int document_id) {
+    const auto document_terms = search_server.GetWordFrequencies(document_id).Terms();
+    std::vector<TermId> terms(document_terms.size());
+    std::transform(document_terms.begin(), document_terms.end(), terms.begin(), [](const SearchServer::DocumentTerm& document_term) {
+        return document_term.term;
+    });
+    return terms;
+}
+
+std::vector<int> GetDocumentIds(SearchServer& search_server) {
+    return { search_server.begin(), search_server.end() };
+}
+
+void RemoveFound(SearchServer& search_server, std::vector<int>& duplicates) {
+    std::sort(duplicates.begin(), duplicates.end());
     for (const int id : duplicates) {
         std::cout << std::string("Found duplicate document id ") << id << std::endl;
         search_server.RemoveDocument(id);
     }
 }
+}
+
+void RemoveDuplicates(SearchServer& search_server) {
+    const std::vector<int> document_ids = GetDocumentIds(search_server);
+    // a sum of mixed word hashes doesn't depend on word order; two independent sums make a 128-bit fingerprint
+    struct FingerprintedDocument {
+        std::array<uint64_t, 2> fingerprint;
+        int id;
+
+        bool operator<(const FingerprintedDocument& other) const {
+            return std::tie(fingerprint, id) < std::tie(other.fingerprint, other.id);
+        }
+    };
+    std::vector<FingerprintedDocument> documents(document_ids.size());
+    std::transform(std::execution::par, document_ids.begin(), document_ids.end(), documents.begin(), [&search_server](int document_id) {
+        FingerprintedDocument document{ { 0, 0 }, document_id };
+        for (const auto& [word, term_freq] : search_server.GetWordFrequencies(document_id)) {
+            const uint64_t hash = std::hash<std::string_view>{}(word);
+            document.fingerprint[0] += Mix(hash);
+            document.fingerprint[1] += Mix(hash ^ 0x9e3779b97f4a7c15ull);
+        }
+        return document;
+    });
+    std::sort(std::execution::par, documents.begin(), documents.end());
+
+    std::vector<size_t> group_begins;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        if (i == 0 || documents[i - 1].fingerprint != documents[i].fingerprint) {
+            group_begins.push_back(i);
+        }
+    }
+    // inside a group the ids ascend; colliding fingerprints are told apart by comparing the words
+    std::vector<std::vector<int>> group_duplicates(group_begins.size());
+    std::vector<size_t> groups(group_begins.size());
+    std::iota(groups.begin(), groups.end(), 0);
+    std::for_each(std::execution::par, groups.begin(), groups.end(), [&](size_t group) {
+        const size_t end = group + 1 < group_begins.size() ? group_begins[group + 1] : documents.size();
+        if (end - group_begins[group] == 1) {
+            return;
+        }
+        std::vector<std::vector<TermId>> kept_words;
+        for (size_t i = group_begins[group]; i < end; ++i) {
+            auto words = GetTermIds(search_server, documents[i].id);
+            if (std::find(kept_words.begin(), kept_words.end(), words) != kept_words.end()) {
+                group_duplicates[group].push_back(documents[i].id);
+            } else {
+                kept_words.push_back(std::move(words));
+            }
+        }
+    });
+
+    std::vector<int> duplicates;
+    for (const auto& ids : group_duplicates) {
+        duplicates.insert(duplicates.end(), ids.begin(), ids.end());
+    }
+    RemoveFound(search_server, duplicates);
+}
+
+void RemoveNearDuplicates(SearchServer& search_server, double min_similarity) {
+    const std::vector<int> document_ids = GetDocumentIds(search_server);
+    std::vector<std::vector<TermId>> words(document_ids.size());
+    std::vector<std::array<uint64_t, MIN_HASH_SIZE>> signatures(document_ids.size());
+    std::vector<size_t> indexes(document_ids.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t index) {
+        words[index] = GetTermIds(search_server, document_ids[index]);
+        auto& signature = signatures[index];
+        signature.fill(UINT64_MAX);
+        for (const TermId word : words[index]) {
+            for (size_t i = 0; i < MIN_HASH_SIZE; ++i) {
+                signature[i] = std::min(signature[i], Mix(word + i * 0x9e3779b97f4a7c15ull));
+            }
+        }
+    });
+
+    const auto similarity = [&words](size_t lhs, size_t rhs) {
+        if (words[lhs].empty() && words[rhs].empty()) {
+            return 1.0;
+        }
+        std::vector<TermId> common;
+        std::set_intersection(words[lhs].begin(), words[lhs].end(), words[rhs].begin(), words[rhs].end(), std::back_inserter(common));
+        return common.size() * 1.0 / (words[lhs].size() + words[rhs].size() - common.size());
+    };
+    // documents are visited in id order; a document is kept unless a kept one shares a band with it and is similar enough
+    std::array<std::unordered_map<uint64_t, std::vector<size_t>>, MIN_HASH_BAND_COUNT> bands;
+    std::vector<int> duplicates;
+    for (size_t index = 0; index < document_ids.size(); ++index) {
+        std::array<uint64_t, MIN_HASH_BAND_COUNT> band_keys;
+        bool is_duplicate = false;
+        for (size_t band = 0; band < MIN_HASH_BAND_COUNT; ++band) {
+            uint64_t key = band;
+            for (size_t row = 0; row < MIN_HASH_BAND_ROWS; ++row) {
+                key = Mix(key ^ signatures[index][band * MIN_HASH_BAND_ROWS + row]);
+            }
+            band_keys[band] = key;
+            const auto it = bands[band].find(key);
+            if (!is_duplicate && it != bands[band].end()) {
+                is_duplicate = std::any_of(it->second.begin(), it->second.end(), [&](size_t kept) {
+                    return similarity(kept, index) >= min_similarity;
+                });
+            }
+        }
+        if (is_duplicate) {
+            duplicates.push_back(document_ids[index]);
+            continue;
+        }
+        for (size_t band = 0; band < MIN_HASH_BAND_COUNT; ++band) {
+            bands[band][band_keys[band]].push_back(index);
+        }
+    }
+    RemoveFound(search_server, duplicates);
+}
@@ -1,4 +1,9 @@
 #pragma once
 #include "search_server.h"
 
-void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
+// Removes every document whose set of words equals the one of a document with a smaller id
+void RemoveDuplicates(SearchServer& search_server);
+// Removes every document whose word set is at least min_similarity Jaccard-similar to the one of a kept
+// document with a smaller id. Candidates are found with MinHash signatures split into LSH bands, so pairs
+// below about 0.5 similarity are rarely even compared; every candidate is verified exactly.
+void RemoveNearDuplicates(SearchServer& search_server, double min_similarity);
@@ -1,16 +1,19 @@
 #include "request_queue.h"
 
-    std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
-        // напишите реализацию
-        return AddFindRequest(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-                return document_status == status;
-            });
-    }
-    std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query) {
-        // напишите реализацию
-        return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
-    }
-    int RequestQueue::GetNoResultRequests() const {
-        // напишите реализацию
-        return empty_requests_.size();
-    }
\ No newline at end of file
+std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
+    return Record([&] {
+        return search_server_.FindTopDocuments(raw_query, status);
+    });
+}
+
+std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query) {
+    return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
+}
+
+int RequestQueue::GetNoResultRequests() const {
+    return static_cast<int>(stats_.GetEmptyRequestsInWindow());
+}
+
+RequestStats::Snapshot RequestQueue::GetStats() const {
+    return stats_.GetSnapshot();
+}
@@ -1,53 +1,46 @@
 #pragma once
 #include "search_server.h"
+#include "request_stats.h"
 #include <string>
-#include <deque>
 #include "document.h"
 #include <vector>
 
+// Runs searches and keeps statistics over the most recent ones. Requests may be added from several
+// threads at once, the statistics are shared and lock-free.
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server)
-    : search_server_(search_server) {       
+    static constexpr size_t DEFAULT_WINDOW_LENGTH = 1440;
+
+    explicit RequestQueue(const SearchServer& search_server, size_t window_length = DEFAULT_WINDOW_LENGTH)
+    : search_server_(search_server)
+    , stats_(window_length) {
     }
     // сделаем "обёртки" для всех методов поиска, чтобы сохранять результаты для нашей статистики
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
-        QueryResult q;
-        ++time_counter;
-        q.time = time_counter;
-        if ((q.time - requests_.front().time) >= min_in_day_) {
-            QueryResult first = requests_.front();
-            if (first.IsEmpty) {
-                requests_.pop_front();
-                empty_requests_.pop_front();
-            }
-            else {
-                requests_.pop_front();
-            }
-        }
-        auto result = search_server_.FindTopDocuments(raw_query, document_predicate);
-        if (!result.empty()) {
-            q.IsEmpty = false;
-            requests_.push_back(q);
-        } else {
-            q.IsEmpty = true;
-            requests_.push_back(q);
-            empty_requests_.push_back(q);
-        }
-        return result;
+        return Record([&] {
+            return search_server_.FindTopDocuments(raw_query, document_predicate);
+        });
     }
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
     std::vector<Document> AddFindRequest(const std::string& raw_query);
+    // Requests without results among the last window_length ones
     int GetNoResultRequests() const;
+    // QPS, empty-result rate and latencies over the last minute
+    RequestStats::Snapshot GetStats() const;
 private:
-    struct QueryResult {
-        bool IsEmpty;
-        int time; 
-    };
-    std::deque<QueryResult> requests_;
-    std::deque<QueryResult> empty_requests_;
-    const static int min_in_day_ = 1440;
-    uint64_t time_counter=0;
     const SearchServer& search_server_;
+    RequestStats stats_;
+
+    template <typename Search>
+    std::vector<Document> Record(Search search);
 };
+
+template <typename Search>
+std::vector<Document> RequestQueue::Record(Search search) {
+    const auto start = RequestStats::Clock::now();
+    auto result = search();
+    const auto finish = RequestStats::Clock::now();
+    stats_.Record(result.empty(), finish - start, finish);
+    return result;
+}
@@ -0,0 +1,102 @@
+#include "request_stats.h"
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <string>
+
+std::chrono::microseconds RequestStats::Snapshot::LatencyPercentile(double share) const {
+    uint64_t total = 0;
+    for (const uint64_t count : latency_histogram) {
+        total += count;
+    }
+    if (total == 0) {
+        return std::chrono::microseconds(0);
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(share * total + 0.5));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; ++bucket) {
+        seen += latency_histogram[bucket];
+        if (seen >= rank) {
+            return std::chrono::microseconds(int64_t{ 1 } << (bucket + 1));
+        }
+    }
+    return std::chrono::microseconds(int64_t{ 1 } << LATENCY_BUCKET_COUNT);
+}
+
+RequestStats::RequestStats(size_t window_length, Clock::duration bucket_duration, size_t bucket_count)
+    : window_length_(window_length)
+    , window_empty_flags_(std::make_unique<std::atomic<uint8_t>[]>(window_length))
+    , bucket_duration_(bucket_duration)
+    , bucket_count_(bucket_count)
+    , start_(Clock::now())
+    , buckets_(std::make_unique<Bucket[]>(bucket_count)) {
+    if (window_length == 0 || bucket_count == 0 || bucket_duration <= Clock::duration::zero()) {
+        throw std::invalid_argument(std::string("Request stats windows must not be empty"));
+    }
+}
+
+void RequestStats::Record(bool is_empty, Clock::duration latency, Clock::time_point now) {
+    // the request replaces the one window_length requests older in its ring slot
+    const uint64_t sequence = request_count_.fetch_add(1, std::memory_order_relaxed);
+    const uint8_t was_empty = window_empty_flags_[sequence % window_length_].exchange(is_empty, std::memory_order_relaxed);
+    if (was_empty != static_cast<uint8_t>(is_empty)) {
+        empty_requests_in_window_.fetch_add(is_empty ? 1 : -1, std::memory_order_relaxed);
+    }
+
+    const int64_t period = GetPeriod(now);
+    Bucket& bucket = buckets_[static_cast<size_t>(period) % bucket_count_];
+    int64_t bucket_period = bucket.period.load(std::memory_order_acquire);
+    while (bucket_period < period) {
+        if (bucket.period.compare_exchange_weak(bucket_period, period, std::memory_order_acq_rel)) {
+            bucket.requests.store(0, std::memory_order_relaxed);
+            bucket.empty_requests.store(0, std::memory_order_relaxed);
+            for (auto& count : bucket.latencies) {
+                count.store(0, std::memory_order_relaxed);
+            }
+            bucket_period = period;
+        }
+    }
+    if (bucket_period != period) {
+        // the recording thread was stalled for a whole window
+        return;
+    }
+    bucket.requests.fetch_add(1, std::memory_order_relaxed);
+    if (is_empty) {
+        bucket.empty_requests.fetch_add(1, std::memory_order_relaxed);
+    }
+    const auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    const size_t latency_bucket = microseconds <= 1 ? 0
+        : std::min<size_t>(LATENCY_BUCKET_COUNT - 1, std::bit_width(static_cast<uint64_t>(microseconds)) - 1);
+    bucket.latencies[latency_bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t RequestStats::GetEmptyRequestsInWindow() const {
+    return static_cast<size_t>(std::max<int64_t>(0, empty_requests_in_window_.load(std::memory_order_relaxed)));
+}
+
+RequestStats::Snapshot RequestStats::GetSnapshot(Clock::time_point now) const {
+    Snapshot snapshot;
+    const int64_t period = GetPeriod(now);
+    for (size_t i = 0; i < bucket_count_; ++i) {
+        const Bucket& bucket = buckets_[i];
+        const int64_t bucket_period = bucket.period.load(std::memory_order_acquire);
+        if (bucket_period > period || bucket_period <= period - static_cast<int64_t>(bucket_count_)) {
+            continue;
+        }
+        snapshot.requests += bucket.requests.load(std::memory_order_relaxed);
+        snapshot.empty_requests += bucket.empty_requests.load(std::memory_order_relaxed);
+        for (size_t latency_bucket = 0; latency_bucket < LATENCY_BUCKET_COUNT; ++latency_bucket) {
+            snapshot.latency_histogram[latency_bucket] += bucket.latencies[latency_bucket].load(std::memory_order_relaxed);
+        }
+    }
+    const auto window = bucket_duration_ * bucket_count_;
+    const auto elapsed = std::max(now - start_, Clock::duration::zero());
+    snapshot.seconds = std::chrono::duration<double>(std::min<Clock::duration>(window, elapsed)).count();
+    snapshot.queries_per_second = snapshot.seconds > 0.0 ? snapshot.requests / snapshot.seconds : 0.0;
+    snapshot.empty_rate = snapshot.requests > 0 ? snapshot.empty_requests * 1.0 / snapshot.requests : 0.0;
+    return snapshot;
+}
+
+int64_t RequestStats::GetPeriod(Clock::time_point time) const {
+    return static_cast<int64_t>(time.time_since_epoch() / bucket_duration_);
+}
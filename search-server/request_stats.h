@@ -0,0 +1,62 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Statistics over the most recent requests in fixed memory, updated with a few relaxed atomics per request,
+// so any number of threads may record and read at once without locks. Two windows are kept:
+// - the last window_length requests, for the number of requests without results;
+// - the last bucket_count time buckets of bucket_duration each, for QPS, the empty-result rate and a
+//   latency histogram. A bucket is recycled by the first request of a new period; requests racing with the
+//   recycling may be lost, so per-bucket counts are approximate at bucket boundaries.
+class RequestStats {
+public:
+    using Clock = std::chrono::steady_clock;
+    // bucket i counts latencies in [2^i, 2^(i+1)) microseconds, bucket 0 also the shorter ones
+    static constexpr size_t LATENCY_BUCKET_COUNT = 32;
+
+    struct Snapshot {
+        uint64_t requests = 0;
+        uint64_t empty_requests = 0;
+        // time covered by the window, shorter than the window while the stats are young
+        double seconds = 0.0;
+        double queries_per_second = 0.0;
+        double empty_rate = 0.0;
+        std::array<uint64_t, LATENCY_BUCKET_COUNT> latency_histogram{};
+
+        // Upper bound of the histogram bucket holding the given share (0.5 for p50) of the latencies
+        std::chrono::microseconds LatencyPercentile(double share) const;
+    };
+
+    explicit RequestStats(size_t window_length, Clock::duration bucket_duration = std::chrono::seconds(1),
+        size_t bucket_count = 60);
+
+    void Record(bool is_empty, Clock::duration latency, Clock::time_point now = Clock::now());
+
+    // Requests without results among the last window_length ones
+    size_t GetEmptyRequestsInWindow() const;
+    Snapshot GetSnapshot(Clock::time_point now = Clock::now()) const;
+
+private:
+    struct Bucket {
+        std::atomic<int64_t> period{ -1 };
+        std::atomic<uint64_t> requests{ 0 };
+        std::atomic<uint64_t> empty_requests{ 0 };
+        std::array<std::atomic<uint64_t>, LATENCY_BUCKET_COUNT> latencies{};
+    };
+
+    const size_t window_length_;
+    std::unique_ptr<std::atomic<uint8_t>[]> window_empty_flags_;
+    std::atomic<uint64_t> request_count_{ 0 };
+    std::atomic<int64_t> empty_requests_in_window_{ 0 };
+
+    const Clock::duration bucket_duration_;
+    const size_t bucket_count_;
+    const Clock::time_point start_;
+    std::unique_ptr<Bucket[]> buckets_;
+
+    int64_t GetPeriod(Clock::time_point time) const;
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include <cmath>
+#include <concepts>
+
+// Relevance models for SearchServer::FindTopDocuments. The model is a template parameter, so all of it is
+// inlined into the scoring loop. Every plus word of a query is weighted once by InverseDocumentFreq, a scored
+// document gets one LengthNorm shared by its matched words and then TermScore per word. WAND skips documents
+// by MaxTermScore, which must not be below TermScore for term frequencies up to max_term_freq in a document
+// of any length.
+template <typename Model>
+concept ScoringModel = requires(const Model& model, int count, double value) {
+    { model.InverseDocumentFreq(count, count) } -> std::convertible_to<double>;
+    { model.LengthNorm(count, value) } -> std::convertible_to<double>;
+    { model.TermScore(value, value, value) } -> std::convertible_to<double>;
+    { model.MaxTermScore(value, value, value) } -> std::convertible_to<double>;
+};
+
+// term frequency * log(document count / document frequency), the default model
+struct TfIdfScoring {
+    double InverseDocumentFreq(int document_count, int document_freq) const {
+        return std::log(document_count * 1.0 / document_freq);
+    }
+    double LengthNorm(int /*word_count*/, double /*average_word_count*/) const {
+        return 0.0;
+    }
+    double TermScore(double term_freq, double /*length_norm*/, double inverse_document_freq) const {
+        return term_freq * inverse_document_freq;
+    }
+    double MaxTermScore(double max_term_freq, double /*average_word_count*/, double inverse_document_freq) const {
+        return max_term_freq * inverse_document_freq;
+    }
+};
+
+// Okapi BM25. Term frequencies are stored as shares of the document words, so the usual
+// idf * (k1 + 1) * count / (count + k1 * (1 - b + b * length / average_length)) is computed divided through by length.
+struct Bm25Scoring {
+    double k1 = 1.2;
+    double b = 0.75;
+
+    double InverseDocumentFreq(int document_count, int document_freq) const {
+        return std::log(1.0 + (document_count - document_freq + 0.5) / (document_freq + 0.5));
+    }
+    double LengthNorm(int word_count, double average_word_count) const {
+        return k1 * (1.0 - b + b * word_count / average_word_count) / word_count;
+    }
+    double TermScore(double term_freq, double length_norm, double inverse_document_freq) const {
+        return inverse_document_freq * (k1 + 1.0) * term_freq / (term_freq + length_norm);
+    }
+    // the norm only shrinks as the length grows, towards k1 * b / average_length
+    double MaxTermScore(double max_term_freq, double average_word_count, double inverse_document_freq) const {
+        if (max_term_freq <= 0.0) {
+            return 0.0;
+        }
+        const double min_length_norm = average_word_count > 0.0 ? k1 * b / average_word_count : 0.0;
+        return inverse_document_freq * (k1 + 1.0) * max_term_freq / (max_term_freq + min_length_norm);
+    }
+};
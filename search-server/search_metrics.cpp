@@ -0,0 +1,222 @@
+#include "search_metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+// Written by its own thread only, read by snapshots from any thread
+struct ThreadMetrics {
+    std::array<std::array<std::atomic<uint64_t>, LatencyHistogram::BUCKET_COUNT>, QUERY_PHASE_COUNT> phase_counts{};
+    std::array<std::atomic<uint64_t>, QUERY_PHASE_COUNT> phase_sums{};
+    std::array<std::atomic<uint64_t>, QUERY_COUNTER_COUNT> counters{};
+};
+
+// Blocks outlive their threads, so metrics stay cumulative; there is one per thread that ever recorded
+struct MetricsRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadMetrics>> threads;
+};
+
+MetricsRegistry& GetMetricsRegistry() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+[[maybe_unused]] ThreadMetrics& GetThreadMetrics() {
+    thread_local ThreadMetrics* metrics = [] {
+        auto& registry = GetMetricsRegistry();
+        std::lock_guard guard(registry.mutex);
+        return registry.threads.emplace_back(std::make_unique<ThreadMetrics>()).get();
+    }();
+    return *metrics;
+}
+
+// the owning thread is the only writer, so a plain load and store are enough
+[[maybe_unused]] void Increase(std::atomic<uint64_t>& value, uint64_t delta) {
+    value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+}
+
+const char* GetQueryPhaseName(QueryPhase phase) {
+    static constexpr std::array<const char*, QUERY_PHASE_COUNT> NAMES = {
+        "parse", "postings", "filter", "minus_words", "top_k" };
+    return NAMES[static_cast<size_t>(phase)];
+}
+
+const char* GetQueryCounterName(QueryCounter counter) {
+    static constexpr std::array<const char*, QUERY_COUNTER_COUNT> NAMES = {
+        "queries", "postings_scanned", "documents_scored" };
+    return NAMES[static_cast<size_t>(counter)];
+}
+
+size_t LatencyHistogram::GetBucket(uint64_t value) {
+    constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{ 1 } << SUB_BUCKET_BITS;
+    if (value < SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(value);
+    }
+    // the leading bit and the SUB_BUCKET_BITS bits after it select the bucket
+    const int exponent = std::bit_width(value) - 1;
+    return (static_cast<size_t>(exponent - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS)
+        + static_cast<size_t>((value >> (exponent - SUB_BUCKET_BITS)) - SUB_BUCKET_COUNT);
+}
+
+uint64_t LatencyHistogram::GetBucketLowerBound(size_t bucket) {
+    constexpr size_t SUB_BUCKET_COUNT = size_t{ 1 } << SUB_BUCKET_BITS;
+    if (bucket < SUB_BUCKET_COUNT) {
+        return bucket;
+    }
+    const int shift = static_cast<int>(bucket >> SUB_BUCKET_BITS) - 1;
+    return (SUB_BUCKET_COUNT + (bucket & (SUB_BUCKET_COUNT - 1))) << shift;
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(size_t bucket) {
+    return bucket + 1 < BUCKET_COUNT ? GetBucketLowerBound(bucket + 1) - 1 : std::numeric_limits<uint64_t>::max();
+}
+
+LatencyHistogram::LatencyHistogram(const std::array<uint64_t, BUCKET_COUNT>& counts, uint64_t sum)
+    : counts_(counts)
+    , sum_(sum) {
+    for (const uint64_t count : counts) {
+        count_ += count;
+    }
+}
+
+void LatencyHistogram::Add(uint64_t value) {
+    ++counts_[GetBucket(value)];
+    ++count_;
+    sum_ += value;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        counts_[bucket] += other.counts_[bucket];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+}
+
+void LatencyHistogram::Subtract(const LatencyHistogram& other) {
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        counts_[bucket] -= std::min(counts_[bucket], other.counts_[bucket]);
+    }
+    count_ -= std::min(count_, other.count_);
+    sum_ -= std::min(sum_, other.sum_);
+}
+
+uint64_t LatencyHistogram::Count() const {
+    return count_;
+}
+
+std::chrono::nanoseconds LatencyHistogram::Mean() const {
+    return std::chrono::nanoseconds(count_ == 0 ? 0 : static_cast<int64_t>(sum_ / count_));
+}
+
+std::chrono::nanoseconds LatencyHistogram::Percentile(double share) const {
+    if (count_ == 0) {
+        return std::chrono::nanoseconds(0);
+    }
+    const uint64_t rank = std::clamp<uint64_t>(static_cast<uint64_t>(share * count_ + 0.5), 1, count_);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        seen += counts_[bucket];
+        if (seen >= rank) {
+            const uint64_t value = std::min<uint64_t>(GetBucketUpperBound(bucket), std::numeric_limits<int64_t>::max());
+            return std::chrono::nanoseconds(static_cast<int64_t>(value));
+        }
+    }
+    return std::chrono::nanoseconds::max();
+}
+
+const LatencyHistogram& QueryMetricsSnapshot::Phase(QueryPhase phase) const {
+    return phases[static_cast<size_t>(phase)];
+}
+
+uint64_t QueryMetricsSnapshot::Counter(QueryCounter counter) const {
+    return counters[static_cast<size_t>(counter)];
+}
+
+QueryMetricsSnapshot TakeQueryMetricsSnapshot() {
+    QueryMetricsSnapshot snapshot;
+    auto& registry = GetMetricsRegistry();
+    std::lock_guard guard(registry.mutex);
+    for (const auto& metrics : registry.threads) {
+        for (size_t phase = 0; phase < QUERY_PHASE_COUNT; ++phase) {
+            std::array<uint64_t, LatencyHistogram::BUCKET_COUNT> counts;
+            for (size_t bucket = 0; bucket < LatencyHistogram::BUCKET_COUNT; ++bucket) {
+                counts[bucket] = metrics->phase_counts[phase][bucket].load(std::memory_order_relaxed);
+            }
+            snapshot.phases[phase].Merge(LatencyHistogram(counts, metrics->phase_sums[phase].load(std::memory_order_relaxed)));
+        }
+        for (size_t counter = 0; counter < QUERY_COUNTER_COUNT; ++counter) {
+            snapshot.counters[counter] += metrics->counters[counter].load(std::memory_order_relaxed);
+        }
+    }
+    return snapshot;
+}
+
+QueryMetricsSnapshot GetQueryMetricsDelta(const QueryMetricsSnapshot& later, const QueryMetricsSnapshot& earlier) {
+    QueryMetricsSnapshot delta = later;
+    for (size_t phase = 0; phase < QUERY_PHASE_COUNT; ++phase) {
+        delta.phases[phase].Subtract(earlier.phases[phase]);
+    }
+    for (size_t counter = 0; counter < QUERY_COUNTER_COUNT; ++counter) {
+        delta.counters[counter] -= std::min(delta.counters[counter], earlier.counters[counter]);
+    }
+    return delta;
+}
+
+void PrintQueryMetrics(const QueryMetricsSnapshot& snapshot, std::ostream& out) {
+    out << "{\"counters\": {";
+    for (size_t counter = 0; counter < QUERY_COUNTER_COUNT; ++counter) {
+        out << (counter == 0 ? "" : ", ") << '"' << GetQueryCounterName(static_cast<QueryCounter>(counter)) << "\": "
+            << snapshot.counters[counter];
+    }
+    out << "},\n\"phases\": {";
+    for (size_t phase = 0; phase < QUERY_PHASE_COUNT; ++phase) {
+        const auto& histogram = snapshot.phases[phase];
+        out << (phase == 0 ? "\n" : ",\n") << "  \"" << GetQueryPhaseName(static_cast<QueryPhase>(phase)) << "\": {"
+            << "\"count\": " << histogram.Count()
+            << ", \"mean_ns\": " << histogram.Mean().count()
+            << ", \"p50_ns\": " << histogram.Percentile(0.5).count()
+            << ", \"p99_ns\": " << histogram.Percentile(0.99).count()
+            << ", \"p999_ns\": " << histogram.Percentile(0.999).count() << "}";
+    }
+    out << "\n}}" << std::endl;
+}
+
+QueryMetricsReporter::QueryMetricsReporter(std::chrono::milliseconds period,
+    std::function<void(const QueryMetricsSnapshot&)> export_metrics)
+    : thread_([period, export_metrics = std::move(export_metrics)](std::stop_token stop_token) {
+        std::mutex mutex;
+        std::condition_variable_any stopped;
+        QueryMetricsSnapshot previous = TakeQueryMetricsSnapshot();
+        std::unique_lock lock(mutex);
+        while (true) {
+            stopped.wait_for(lock, stop_token, period, [] { return false; });
+            if (stop_token.stop_requested()) {
+                break;
+            }
+            QueryMetricsSnapshot current = TakeQueryMetricsSnapshot();
+            export_metrics(GetQueryMetricsDelta(current, previous));
+            previous = std::move(current);
+        }
+    }) {
+}
+
+#if SEARCH_SERVER_METRICS
+void RecordQueryPhase(QueryPhase phase, std::chrono::nanoseconds duration) {
+    auto& metrics = GetThreadMetrics();
+    const uint64_t value = static_cast<uint64_t>(std::max<int64_t>(0, duration.count()));
+    Increase(metrics.phase_counts[static_cast<size_t>(phase)][LatencyHistogram::GetBucket(value)], 1);
+    Increase(metrics.phase_sums[static_cast<size_t>(phase)], value);
+}
+
+void AddQueryCounter(QueryCounter counter, uint64_t value) {
+    Increase(GetThreadMetrics().counters[static_cast<size_t>(counter)], value);
+}
+#endif
@@ -0,0 +1,194 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <thread>
+
+// Query metrics are recorded unless the build defines SEARCH_SERVER_METRICS=0, which turns the recording
+// functions and timers below into empty inline code
+#ifndef SEARCH_SERVER_METRICS
+#define SEARCH_SERVER_METRICS 1
+#endif
+
+inline constexpr bool METRICS_ENABLED = SEARCH_SERVER_METRICS != 0;
+
+enum class QueryPhase {
+    PARSE,
+    // document-at-a-time traversal, the filter and minus word checks made during it included
+    POSTINGS,
+    // estimated from sampled documents, recorded once per docid range a thread traverses
+    FILTER,
+    MINUS_WORDS,
+    TOP_K,
+};
+inline constexpr size_t QUERY_PHASE_COUNT = 5;
+
+enum class QueryCounter {
+    QUERIES,
+    // postings the traversal stopped at; postings skipped over in blocks are not counted
+    POSTINGS_SCANNED,
+    DOCUMENTS_SCORED,
+};
+inline constexpr size_t QUERY_COUNTER_COUNT = 3;
+
+const char* GetQueryPhaseName(QueryPhase phase);
+const char* GetQueryCounterName(QueryCounter counter);
+
+// HDR-style histogram of nanosecond durations: every power of two is split into 2^SUB_BUCKET_BITS linear
+// buckets, so values are kept within 1/16 of themselves over the whole uint64_t range in fixed memory
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr size_t BUCKET_COUNT = size_t{ 65 - SUB_BUCKET_BITS } << SUB_BUCKET_BITS;
+
+    static size_t GetBucket(uint64_t value);
+    static uint64_t GetBucketLowerBound(size_t bucket);
+    static uint64_t GetBucketUpperBound(size_t bucket);
+
+    LatencyHistogram() = default;
+    // sum is the total of the values counted
+    LatencyHistogram(const std::array<uint64_t, BUCKET_COUNT>& counts, uint64_t sum);
+
+    void Add(uint64_t value);
+    void Merge(const LatencyHistogram& other);
+    // other must be an earlier state of this histogram
+    void Subtract(const LatencyHistogram& other);
+
+    uint64_t Count() const;
+    std::chrono::nanoseconds Mean() const;
+    // Highest value of the bucket holding the given share (0.5 for p50) of the values
+    std::chrono::nanoseconds Percentile(double share) const;
+
+private:
+    std::array<uint64_t, BUCKET_COUNT> counts_{};
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+};
+
+struct QueryMetricsSnapshot {
+    std::array<LatencyHistogram, QUERY_PHASE_COUNT> phases;
+    std::array<uint64_t, QUERY_COUNTER_COUNT> counters{};
+
+    const LatencyHistogram& Phase(QueryPhase phase) const;
+    uint64_t Counter(QueryCounter counter) const;
+};
+
+// Sums what every thread has recorded since the start of the process
+QueryMetricsSnapshot TakeQueryMetricsSnapshot();
+// Metrics recorded between two snapshots
+QueryMetricsSnapshot GetQueryMetricsDelta(const QueryMetricsSnapshot& later, const QueryMetricsSnapshot& earlier);
+// Writes the counters and the count, mean, p50, p99 and p999 of every phase as one JSON object
+void PrintQueryMetrics(const QueryMetricsSnapshot& snapshot, std::ostream& out);
+
+// Passes the metrics recorded during every period to export_metrics, called from a thread of its own,
+// until destruction
+class QueryMetricsReporter {
+public:
+    QueryMetricsReporter(std::chrono::milliseconds period, std::function<void(const QueryMetricsSnapshot&)> export_metrics);
+
+private:
+    std::jthread thread_;
+};
+
+#if SEARCH_SERVER_METRICS
+void RecordQueryPhase(QueryPhase phase, std::chrono::nanoseconds duration);
+void AddQueryCounter(QueryCounter counter, uint64_t value);
+#else
+inline void RecordQueryPhase(QueryPhase, std::chrono::nanoseconds) {
+}
+inline void AddQueryCounter(QueryCounter, uint64_t) {
+}
+#endif
+
+// Records the time from construction to destruction as one phase
+class QueryPhaseTimer {
+public:
+    explicit QueryPhaseTimer(QueryPhase phase);
+    ~QueryPhaseTimer();
+
+private:
+#if SEARCH_SERVER_METRICS
+    QueryPhase phase_;
+    std::chrono::steady_clock::time_point start_;
+#endif
+};
+
+// Estimates phases interleaved in a per-document loop, where reading the clock every time would cost
+// more than the phases: every SAMPLE_PERIOD-th iteration is timed and the totals are scaled up and
+// recorded on destruction
+class QueryPhaseSampler {
+public:
+    static constexpr uint32_t SAMPLE_PERIOD = 16;
+
+    ~QueryPhaseSampler();
+
+    void NextIteration();
+    void Start();
+    void Stop(QueryPhase phase);
+
+private:
+#if SEARCH_SERVER_METRICS
+    uint32_t iteration_ = 0;
+    bool is_sampled_ = false;
+    std::chrono::steady_clock::time_point start_;
+    std::array<std::chrono::nanoseconds, QUERY_PHASE_COUNT> totals_{};
+    std::array<bool, QUERY_PHASE_COUNT> is_timed_{};
+#endif
+};
+
+#if SEARCH_SERVER_METRICS
+inline QueryPhaseTimer::QueryPhaseTimer(QueryPhase phase)
+    : phase_(phase)
+    , start_(std::chrono::steady_clock::now()) {
+}
+
+inline QueryPhaseTimer::~QueryPhaseTimer() {
+    RecordQueryPhase(phase_, std::chrono::steady_clock::now() - start_);
+}
+
+inline QueryPhaseSampler::~QueryPhaseSampler() {
+    for (size_t phase = 0; phase < QUERY_PHASE_COUNT; ++phase) {
+        if (is_timed_[phase]) {
+            RecordQueryPhase(static_cast<QueryPhase>(phase), totals_[phase] * SAMPLE_PERIOD);
+        }
+    }
+}
+
+inline void QueryPhaseSampler::NextIteration() {
+    is_sampled_ = iteration_++ % SAMPLE_PERIOD == 0;
+}
+
+inline void QueryPhaseSampler::Start() {
+    if (is_sampled_) {
+        start_ = std::chrono::steady_clock::now();
+    }
+}
+
+inline void QueryPhaseSampler::Stop(QueryPhase phase) {
+    if (is_sampled_) {
+        totals_[static_cast<size_t>(phase)] += std::chrono::steady_clock::now() - start_;
+        is_timed_[static_cast<size_t>(phase)] = true;
+    }
+}
+#else
+inline QueryPhaseTimer::QueryPhaseTimer(QueryPhase) {
+}
+
+inline QueryPhaseTimer::~QueryPhaseTimer() {
+}
+
+inline QueryPhaseSampler::~QueryPhaseSampler() {
+}
+
+inline void QueryPhaseSampler::NextIteration() {
+}
+
+inline void QueryPhaseSampler::Start() {
+}
+
+inline void QueryPhaseSampler::Stop(QueryPhase) {
+}
+#endif
@@ -1,6 +1,28 @@
+#include <exception>
+#include <fstream>
 #include <numeric>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
 #include "search_server.h"
 
+namespace {
+// Partial inverted index built by one thread over a run of a batch
+struct IndexedChunk {
+    size_t begin = 0;
+    size_t end = 0;
+    std::unordered_map<std::string_view, uint32_t> word_ids;
+    std::vector<std::string_view> words;
+    std::vector<std::vector<std::pair<int, double>>> postings;
+    std::vector<std::vector<std::pair<uint32_t, double>>> document_word_freqs;
+    // word sequences of the documents, kept only when positions are indexed
+    std::vector<std::vector<uint32_t>> document_words;
+    std::vector<int> word_counts;
+    std::vector<TermId> terms;
+    std::exception_ptr error;
+};
+}
+
 std::set <int>::iterator SearchServer::begin() {
     return document_ids_.begin();
 }
@@ -12,52 +34,424 @@ void SearchServer::AddDocument(int document_id, const std::string_view document,
     if (document_id < 0) {
         throw std::invalid_argument(std::string("Invalid document_id"));
     }
+    if (static_cast<size_t>(status) >= DocumentColumns::STATUS_COUNT) {
+        throw std::invalid_argument(std::string("Invalid document status"));
+    }
 
-    if (documents_.count(document_id) > 0) {
+    if (columns_.Contains(document_id)) {
         throw std::invalid_argument(std::string("Document with your id has exist yet"));
     }
-    const auto words = SplitIntoWordsNoStop(document);
-    std::set <std::string, std::less<>> text_;
+    std::vector<std::string_view> words;
+    SplitIntoWordsNoStop(document, words);
+    std::vector<TermId> terms(words.size());
+    std::transform(words.begin(), words.end(), terms.begin(), [this](const std::string_view word) {
+        return terms_.Intern(word);
+    });
+    if (index_positions_) {
+        document_positions_.emplace(document_id, DocumentPositions(terms));
+    }
+    std::sort(terms.begin(), terms.end());
+    auto& document_terms = document_terms_[document_id];
     const double inv_word_count = 1.0 / words.size();
-    for (const auto word : words) {
-        auto push_it = text_.insert(std::string(word));
-        word_to_document_freqs_[static_cast <std::string_view> (*push_it.first)][document_id] += inv_word_count;
-        id_to_word_freqs_[document_id][static_cast <std::string_view> (*push_it.first)] += inv_word_count;
-        //здесь нужно добавлять документы в id_to_words_freqs, вычисляя частоту слов документа в этом документе
+    for (size_t i = 0; i < terms.size(); ++i) {
+        if (i == 0 || terms[i] != terms[i - 1]) {
+            document_terms.push_back({ terms[i], 0.0 });
+        }
+        document_terms.back().term_freq += inv_word_count;
     }
-    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status, std::move(text_) });
+    if (term_postings_.size() < terms_.Size()) {
+        term_postings_.resize(terms_.Size());
+    }
+    for (const auto& [term, term_freq] : document_terms) {
+        term_postings_[term].Add(document_id, term_freq);
+    }
+    columns_.Insert(document_id, DocumentData{ ComputeAverageRating(ratings), status, static_cast<int>(words.size()) });
     document_ids_.insert(document_id);
+    total_word_count_ += words.size();
+    ++generation_;
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(std::execution::seq,
-        raw_query, [status](int document_id, DocumentStatus document_status = DocumentStatus::ACTUAL, int rating) {
-            return document_status == status;
-        });
+void SearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    AddDocumentsBatch(std::execution::seq, documents);
 }
 
-int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+void SearchServer::AddDocuments(const std::execution::sequenced_policy& policy, const std::vector<NewDocument>& documents) {
+    AddDocumentsBatch(policy, documents);
 }
 
-SearchServer::MatchResult SearchServer::MatchDocument(const std::string_view raw_query,
-    int document_id) const {//LOG_DURATION_STREAM(std::string("Operation time"), std::cout);
-    const auto query = ParseQuery(raw_query);
-    if (std::any_of(query.minus_words.begin(), query.minus_words.end(), [this, document_id](const auto word) {
-        return (word_to_document_freqs_.count(word) && word_to_document_freqs_.at(word).count(document_id));
-        })) {
-        return { {}, documents_.at(document_id).status };
+void SearchServer::AddDocuments(const std::execution::parallel_policy& policy, const std::vector<NewDocument>& documents) {
+    AddDocumentsBatch(policy, documents);
+}
+
+template <typename PolicyType>
+void SearchServer::AddDocumentsBatch(const PolicyType& policy, const std::vector<NewDocument>& documents) {
+    // documents are processed in id order so that postings are appended instead of inserted
+    std::vector<const NewDocument*> sorted(documents.size());
+    std::transform(documents.begin(), documents.end(), sorted.begin(), [](const NewDocument& document) {
+        return &document;
+    });
+    std::sort(sorted.begin(), sorted.end(), [](const NewDocument* lhs, const NewDocument* rhs) {
+        return lhs->id < rhs->id;
+    });
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        if (sorted[i]->id < 0) {
+            throw std::invalid_argument(std::string("Invalid document_id"));
+        }
+        if (static_cast<size_t>(sorted[i]->status) >= DocumentColumns::STATUS_COUNT) {
+            throw std::invalid_argument(std::string("Invalid document status"));
+        }
+        if (columns_.Contains(sorted[i]->id) || (i > 0 && sorted[i - 1]->id == sorted[i]->id)) {
+            throw std::invalid_argument(std::string("Document with your id has exist yet"));
+        }
     }
-    std::vector<std::string_view> matched_words;
-    for (const std::string_view word : query.plus_words) {
-        if (!word_to_document_freqs_.count(word)) {
+
+    const size_t chunk_count = std::min<size_t>(sorted.size(), 4 * std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<IndexedChunk> chunks(chunk_count);
+    for (size_t i = 0; i < chunk_count; ++i) {
+        chunks[i].begin = sorted.size() * i / chunk_count;
+        chunks[i].end = sorted.size() * (i + 1) / chunk_count;
+    }
+    std::for_each(policy, chunks.begin(), chunks.end(), [&](IndexedChunk& chunk) {
+        try {
+            std::vector<std::string_view> words;
+            for (size_t i = chunk.begin; i < chunk.end; ++i) {
+                SplitIntoWordsNoStop(sorted[i]->text, words);
+                std::map<uint32_t, double> word_freqs;
+                std::vector<uint32_t> document_words;
+                const double inv_word_count = 1.0 / words.size();
+                for (const auto word : words) {
+                    const auto [it, inserted] = chunk.word_ids.emplace(word, static_cast<uint32_t>(chunk.words.size()));
+                    if (inserted) {
+                        chunk.words.push_back(word);
+                        chunk.postings.emplace_back();
+                    }
+                    word_freqs[it->second] += inv_word_count;
+                    if (index_positions_) {
+                        document_words.push_back(it->second);
+                    }
+                }
+                for (const auto& [word, term_freq] : word_freqs) {
+                    chunk.postings[word].emplace_back(sorted[i]->id, term_freq);
+                }
+                chunk.document_word_freqs.emplace_back(word_freqs.begin(), word_freqs.end());
+                chunk.document_words.push_back(std::move(document_words));
+                chunk.word_counts.push_back(static_cast<int>(words.size()));
+            }
+        } catch (...) {
+            chunk.error = std::current_exception();
+        }
+    });
+    for (const auto& chunk : chunks) {
+        if (chunk.error) {
+            std::rethrow_exception(chunk.error);
+        }
+    }
+
+    // one pass over the partial indexes: each word's postings are appended chunk by chunk, words in parallel
+    std::vector<std::tuple<TermId, size_t, uint32_t>> sources;
+    for (size_t chunk_index = 0; chunk_index < chunks.size(); ++chunk_index) {
+        auto& chunk = chunks[chunk_index];
+        for (uint32_t word = 0; word < chunk.words.size(); ++word) {
+            chunk.terms.push_back(terms_.Intern(chunk.words[word]));
+            sources.emplace_back(chunk.terms.back(), chunk_index, word);
+        }
+    }
+    term_postings_.resize(terms_.Size());
+    std::sort(sources.begin(), sources.end());
+    std::vector<size_t> term_begins;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        if (i == 0 || std::get<0>(sources[i - 1]) != std::get<0>(sources[i])) {
+            term_begins.push_back(i);
+        }
+    }
+    std::for_each(policy, term_begins.begin(), term_begins.end(), [&](size_t begin) {
+        PostingList& postings = term_postings_[std::get<0>(sources[begin])];
+        for (size_t i = begin; i < sources.size() && std::get<0>(sources[i]) == std::get<0>(sources[begin]); ++i) {
+            for (const auto& [document_id, term_freq] : chunks[std::get<1>(sources[i])].postings[std::get<2>(sources[i])]) {
+                postings.Add(document_id, term_freq);
+            }
+        }
+    });
+
+    for (const auto& chunk : chunks) {
+        for (size_t i = chunk.begin; i < chunk.end; ++i) {
+            const NewDocument& document = *sorted[i];
+            auto& document_terms = document_terms_[document.id];
+            for (const auto& [word, term_freq] : chunk.document_word_freqs[i - chunk.begin]) {
+                document_terms.push_back({ chunk.terms[word], term_freq });
+            }
+            std::sort(document_terms.begin(), document_terms.end(), [](const DocumentTerm& lhs, const DocumentTerm& rhs) {
+                return lhs.term < rhs.term;
+            });
+            if (index_positions_) {
+                const auto& document_words = chunk.document_words[i - chunk.begin];
+                std::vector<TermId> word_terms(document_words.size());
+                std::transform(document_words.begin(), document_words.end(), word_terms.begin(), [&chunk](uint32_t word) {
+                    return chunk.terms[word];
+                });
+                document_positions_.emplace_hint(document_positions_.end(), document.id, DocumentPositions(word_terms));
+            }
+            columns_.Insert(document.id,
+                DocumentData{ ComputeAverageRating(document.ratings), document.status, chunk.word_counts[i - chunk.begin] });
+            document_ids_.insert(document_ids_.end(), document.id);
+            total_word_count_ += chunk.word_counts[i - chunk.begin];
+        }
+    }
+    ++generation_;
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status,
+    size_t top_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, status, top_count);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const CorpusStats& corpus_stats, const std::string_view raw_query,
+    DocumentStatus status, size_t top_count) const {
+    return FindTopDocuments(corpus_stats, raw_query, StatusPredicate{ status }, top_count);
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+    DocumentStatus status, size_t top_count) const {
+    std::vector<Query> queries(raw_queries.size());
+    std::vector<std::exception_ptr> errors(raw_queries.size());
+    std::vector<size_t> indexes(raw_queries.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t index) {
+        try {
+            queries[index] = ParseQuery(raw_queries[index]);
+        } catch (...) {
+            errors[index] = std::current_exception();
+        }
+    });
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // parsed queries are canonical (sorted, deduplicated words), so equal ones end up adjacent
+    std::sort(indexes.begin(), indexes.end(), [&queries](size_t lhs, size_t rhs) {
+        return queries[lhs] < queries[rhs];
+    });
+    std::vector<size_t> distinct;
+    for (size_t i = 0; i < indexes.size(); ++i) {
+        if (i == 0 || queries[indexes[i - 1]] != queries[indexes[i]]) {
+            distinct.push_back(i);
+        }
+    }
+
+    std::vector<std::optional<std::vector<Document>>> distinct_results(distinct.size());
+    std::vector<bool> is_cached(distinct.size(), false);
+    if (result_cache_) {
+        for (size_t i = 0; i < distinct.size(); ++i) {
+            distinct_results[i] = result_cache_->Find({ generation_, queries[indexes[distinct[i]]], status, top_count });
+            is_cached[i] = distinct_results[i].has_value();
+        }
+    }
+    // a word in several of the queries left is worth one shared traversal, the rest run with WAND
+    std::map<TermId, size_t> term_query_counts;
+    for (size_t i = 0; i < distinct.size(); ++i) {
+        if (!is_cached[i]) {
+            for (const TermId term : queries[indexes[distinct[i]]].plus_terms) {
+                ++term_query_counts[term];
+            }
+        }
+    }
+    std::vector<size_t> shared;
+    std::vector<size_t> separate;
+    for (size_t i = 0; i < distinct.size(); ++i) {
+        if (is_cached[i]) {
             continue;
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
+        const auto& plus_terms = queries[indexes[distinct[i]]].plus_terms;
+        const bool is_shared = std::any_of(plus_terms.begin(), plus_terms.end(), [&term_query_counts](TermId term) {
+            return term_query_counts[term] > 1;
+        });
+        (is_shared ? shared : separate).push_back(i);
+    }
+    std::vector<const Query*> shared_queries;
+    shared_queries.reserve(shared.size());
+    for (const size_t i : shared) {
+        shared_queries.push_back(&queries[indexes[distinct[i]]]);
+    }
+    auto shared_results = FindAllDocumentsShared(shared_queries, status, top_count);
+    for (size_t j = 0; j < shared.size(); ++j) {
+        distinct_results[shared[j]] = std::move(shared_results[j]);
+    }
+    const StatusPredicate document_predicate{ status };
+    std::for_each(std::execution::par, separate.begin(), separate.end(), [&](size_t i) {
+        distinct_results[i] = FindAllDocuments(std::execution::seq, TfIdfScoring{},
+            FindQueryPostings(TfIdfScoring{}, queries[indexes[distinct[i]]]), document_predicate, top_count);
+    });
+
+    std::vector<std::vector<Document>> results(raw_queries.size());
+    for (size_t i = 0; i < distinct.size(); ++i) {
+        const size_t begin = distinct[i];
+        const Query& query = queries[indexes[begin]];
+        if (result_cache_ && !is_cached[i]) {
+            result_cache_->Insert({ generation_, query, status, top_count }, *distinct_results[i]);
+        }
+        for (size_t k = begin + 1; k < indexes.size() && queries[indexes[k]] == query; ++k) {
+            results[indexes[k]] = *distinct_results[i];
+        }
+        results[indexes[begin]] = std::move(*distinct_results[i]);
+    }
+    return results;
+}
+
+// Every part of the docid range is walked in blocks: the postings of each word falling in the block are
+// scored once and added to the accumulators of the queries holding the word, then each query filters and
+// collects the documents it matched. Words are visited in word order, the order each query's words are
+// summed in by FindDocumentsInRange, so relevances are bit-identical to the ones WAND computes.
+std::vector<std::vector<Document>> SearchServer::FindAllDocumentsShared(std::span<const Query* const> queries,
+    DocumentStatus status, size_t top_count) const {
+    constexpr int64_t BLOCK_SIZE = 1024;
+    std::vector<std::vector<Document>> results(queries.size());
+    if (queries.empty()) {
+        return results;
+    }
+    AddQueryCounter(QueryCounter::QUERIES, queries.size());
+    if (document_ids_.empty()) {
+        return results;
+    }
+    const TfIdfScoring scoring;
+    std::vector<QueryPostings> query_postings;
+    query_postings.reserve(queries.size());
+    for (const Query* query : queries) {
+        query_postings.push_back(FindQueryPostings(scoring, *query));
+    }
+    struct SharedWord {
+        const PostingList* postings = nullptr;
+        double inverse_document_freq = 0.0;
+        std::vector<size_t> queries;
+    };
+    std::map<std::string_view, SharedWord> words_by_text;
+    for (size_t query = 0; query < queries.size(); ++query) {
+        // plus_words are empty for queries with a phrase word missing from the index
+        const auto& plus_words = query_postings[query].plus_words;
+        for (size_t i = 0; i < plus_words.size(); ++i) {
+            auto& word = words_by_text[terms_.GetTerm(queries[query]->plus_terms[i])];
+            word.postings = plus_words[i].postings;
+            word.inverse_document_freq = plus_words[i].inverse_document_freq;
+            word.queries.push_back(query);
+        }
+    }
+    std::vector<SharedWord> words;
+    words.reserve(words_by_text.size());
+    for (auto& [text, word] : words_by_text) {
+        words.push_back(std::move(word));
+    }
+
+    const int64_t min_id = *document_ids_.begin();
+    const int64_t id_span = static_cast<int64_t>(*document_ids_.rbegin()) - min_id + 1;
+    const int64_t part_count = std::min<int64_t>((id_span + BLOCK_SIZE - 1) / BLOCK_SIZE,
+        std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::vector<TopDocuments>> part_tops(part_count);
+    std::vector<int64_t> parts(part_count);
+    std::iota(parts.begin(), parts.end(), 0);
+    {
+        const QueryPhaseTimer timer(QueryPhase::POSTINGS);
+        std::for_each(std::execution::par, parts.begin(), parts.end(), [&](int64_t part) {
+            const int64_t range_begin = min_id + id_span * part / part_count;
+            const int64_t range_end = min_id + id_span * (part + 1) / part_count;
+            auto& tops = part_tops[part];
+            tops.reserve(queries.size());
+            for (size_t query = 0; query < queries.size(); ++query) {
+                tops.emplace_back(top_count);
+            }
+            std::vector<PostingList::Cursor> cursors;
+            cursors.reserve(words.size());
+            for (const auto& word : words) {
+                cursors.emplace_back(*word.postings).SkipTo(static_cast<int>(range_begin));
+            }
+            // accumulators of the current block, query-major; matched offsets are kept in touch order
+            std::vector<double> relevances(queries.size() * BLOCK_SIZE, 0.0);
+            std::vector<uint8_t> is_matched(queries.size() * BLOCK_SIZE, 0);
+            std::vector<std::vector<uint32_t>> matched(queries.size());
+            uint64_t postings_scanned = 0;
+            uint64_t documents_scored = 0;
+            for (int64_t block_begin = range_begin; block_begin < range_end; block_begin += BLOCK_SIZE) {
+                const int64_t block_end = std::min(range_end, block_begin + BLOCK_SIZE);
+                for (size_t word = 0; word < words.size(); ++word) {
+                    auto& cursor = cursors[word];
+                    for (; !cursor.IsEnd() && cursor.DocumentId() < block_end; cursor.Next()) {
+                        const int document_id = cursor.DocumentId();
+                        const uint32_t offset = static_cast<uint32_t>(document_id - block_begin);
+                        const double length_norm = scoring.LengthNorm(columns_.WordCount(document_id),
+                            query_postings[words[word].queries.front()].average_word_count);
+                        const double term_score = scoring.TermScore(cursor.TermFreq(), length_norm, words[word].inverse_document_freq);
+                        for (const size_t query : words[word].queries) {
+                            const size_t cell = query * BLOCK_SIZE + offset;
+                            if (!is_matched[cell]) {
+                                is_matched[cell] = 1;
+                                matched[query].push_back(offset);
+                            }
+                            relevances[cell] += term_score;
+                        }
+                        ++postings_scanned;
+                    }
+                }
+                for (size_t query = 0; query < queries.size(); ++query) {
+                    auto& offsets = matched[query];
+                    std::sort(offsets.begin(), offsets.end());
+                    for (const uint32_t offset : offsets) {
+                        const size_t cell = query * BLOCK_SIZE + offset;
+                        const int document_id = static_cast<int>(block_begin + offset);
+                        const double relevance = relevances[cell];
+                        relevances[cell] = 0.0;
+                        is_matched[cell] = 0;
+                        if (!columns_.HasStatus(document_id, status)) {
+                            continue;
+                        }
+                        const auto& minus_postings = query_postings[query].minus_postings;
+                        const bool has_minus_word = std::any_of(minus_postings.begin(), minus_postings.end(),
+                            [document_id](const PostingList* postings) {
+                                return postings->Contains(document_id);
+                            });
+                        if (has_minus_word) {
+                            continue;
+                        }
+                        ++documents_scored;
+                        if (MatchesPhrases(document_id, query_postings[query].phrases)) {
+                            tops[query].Push({ document_id, relevance, columns_.Rating(document_id) });
+                        }
+                    }
+                    offsets.clear();
+                }
+            }
+            AddQueryCounter(QueryCounter::POSTINGS_SCANNED, postings_scanned);
+            AddQueryCounter(QueryCounter::DOCUMENTS_SCORED, documents_scored);
+        });
+    }
+    const QueryPhaseTimer timer(QueryPhase::TOP_K);
+    for (size_t query = 0; query < queries.size(); ++query) {
+        TopDocuments top_documents(top_count);
+        for (auto& tops : part_tops) {
+            for (const Document& document : tops[query].Extract()) {
+                top_documents.Push(document);
+            }
         }
+        results[query] = top_documents.Extract();
     }
-    return { matched_words, documents_.at(document_id).status };
+    return results;
+}
+
+int SearchServer::GetDocumentCount() const {
+    return document_ids_.size();
+}
+
+SearchServer::CorpusStats SearchServer::GetCorpusStats(const std::string_view raw_query) const {
+    CorpusStats corpus_stats;
+    corpus_stats.document_count = GetDocumentCount();
+    for (const TermId term : ParseQuery(raw_query).plus_terms) {
+        corpus_stats.document_freqs.emplace(terms_.GetTerm(term), static_cast<int>(term_postings_[term].Size()));
+    }
+    return corpus_stats;
+}
+
+SearchServer::MatchResult SearchServer::MatchDocument(const std::string_view raw_query,
+    int document_id) const {//LOG_DURATION_STREAM(std::string("Operation time"), std::cout);
+    return MatchQuery(ParseQuery(raw_query), document_id);
 }
 
 SearchServer::MatchResult  SearchServer::MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query,
@@ -65,47 +459,89 @@ SearchServer::MatchResult  SearchServer::MatchDocument(const std::execution::seq
     return MatchDocument(raw_query, document_id);
 }
 
+// a single document has too few words to split between threads, parallelism pays off across documents
 SearchServer::MatchResult SearchServer::MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query,
     int document_id) const {
-    auto query = ParseQueryPar(raw_query);
-    std::vector<std::string_view> matched_words(query.plus_words.size());
-    //сначала проверка на минус-слова
-    if (std::any_of(query.minus_words.begin(), query.minus_words.end(), [this, document_id](auto word) {
-        return (documents_.count(document_id) && documents_.at(document_id).text.count(word));//проверка на наличие слов должна быть организована в другом хранилище - documents_.at(document_id).text.count(word)
-        })) {
-        return { {}, documents_.at(document_id).status };
-    }
-    //проверка на плюс-слова documents_.at(document_id).text.count(word)    
-    auto words_end = std::copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), [&](auto word) {
-        return (documents_.count(document_id) && documents_.at(document_id).text.count(word));
-        });
-    std::sort(matched_words.begin(), words_end);
-    auto it_end_second = std::unique(matched_words.begin(), words_end);
-    matched_words.erase(it_end_second, matched_words.end());
-    return { matched_words, documents_.at(document_id).status };
+    return MatchDocument(raw_query, document_id);
+}
+
+std::vector<SearchServer::MatchResult> SearchServer::MatchDocuments(const std::string_view raw_query,
+    std::span<const int> document_ids) const {
+    return MatchDocumentsBatch(std::execution::seq, raw_query, document_ids);
+}
+
+std::vector<SearchServer::MatchResult> SearchServer::MatchDocuments(const std::execution::sequenced_policy& policy,
+    const std::string_view raw_query, std::span<const int> document_ids) const {
+    return MatchDocumentsBatch(policy, raw_query, document_ids);
 }
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    static std::map <std::string_view, double> result;
-    if (id_to_word_freqs_.count(document_id)) {
-        result = id_to_word_freqs_.at(document_id);
+std::vector<SearchServer::MatchResult> SearchServer::MatchDocuments(const std::execution::parallel_policy& policy,
+    const std::string_view raw_query, std::span<const int> document_ids) const {
+    return MatchDocumentsBatch(policy, raw_query, document_ids);
+}
+
+template <typename PolicyType>
+std::vector<SearchServer::MatchResult> SearchServer::MatchDocumentsBatch(const PolicyType& policy,
+    const std::string_view raw_query, std::span<const int> document_ids) const {
+    const Query query = ParseQuery(raw_query);
+    std::vector<MatchResult> results(document_ids.size());
+    std::vector<std::exception_ptr> errors(document_ids.size());
+    std::vector<size_t> indexes(document_ids.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t index) {
+        try {
+            results[index] = MatchQuery(query, document_ids[index]);
+        } catch (...) {
+            errors[index] = std::current_exception();
+        }
+    });
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
     }
-    return result;
+    return results;
+}
+
+SearchServer::MatchResult SearchServer::MatchQuery(const Query& query, int document_id) const {
+    const auto& document_terms = document_terms_.at(document_id);
+    const DocumentStatus status = columns_.Status(document_id);
+    const auto contains_term = [&document_terms](TermId term) {
+        return FindDocumentTerm(document_terms, term) < document_terms.size();
+    };
+    if (std::any_of(query.minus_terms.begin(), query.minus_terms.end(), contains_term)
+        || !MatchesPhrases(document_id, query.phrases)) {
+        return { std::vector<std::string_view>{}, status };
+    }
+    std::vector<std::string_view> matched_words;
+    for (const TermId term : query.plus_terms) {
+        if (contains_term(term)) {
+            matched_words.push_back(terms_.GetTerm(term));
+        }
+    }
+    return { matched_words, status };
+}
+
+SearchServer::WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+    const auto it = document_terms_.find(document_id);
+    if (it == document_terms_.end()) {
+        return {};
+    }
+    return { &terms_, it->second };
 }
 void SearchServer::RemoveDocument(int document_id) {
-    if (!id_to_word_freqs_.count(document_id)) {
+    if (!document_terms_.count(document_id)) {
         return;
     }
-    std::vector <std::string_view> container;
-    for (auto words : id_to_word_freqs_.at(document_id)) {
-        container.push_back(words.first);
+    for (const auto& [term, term_freq] : document_terms_.at(document_id)) {
+        term_postings_[term].Remove(document_id);
     }
-    for (auto word : container) {
-        word_to_document_freqs_.at(word).erase(document_id);
-    }
-    documents_.erase(document_id);
-    id_to_word_freqs_.erase(document_id);
+    total_word_count_ -= columns_.WordCount(document_id);
+    columns_.Erase(document_id);
+    document_terms_.erase(document_id);
+    document_positions_.erase(document_id);
     document_ids_.erase(document_id);
+    ++generation_;
 }
 
 void SearchServer::RemoveDocument(const std::execution::sequenced_policy&, int document_id) {
@@ -113,23 +549,247 @@ void SearchServer::RemoveDocument(const std::execution::sequenced_policy&, int d
 }
 
 void SearchServer::RemoveDocument(const std::execution::parallel_policy&, int document_id) {
-    if (!id_to_word_freqs_.count(document_id)) { return; }
-    auto& word_freqs = id_to_word_freqs_.at(document_id);
-    std::vector <const std::string_view*> new_vec(word_freqs.size());//создаем вектор указателей для слов
-    std::transform(std::execution::par, word_freqs.begin(), word_freqs.end(), new_vec.begin(),
-        [&](const auto& adress) {
-            return &adress.first;
-        });//закидываем в этот вектор адреса всех слов базы документов
-    std::for_each(std::execution::par, new_vec.begin(), new_vec.end(), [&](const auto& adress) {//Используем for_each для этого вектора и удаляем документы из нужной мапы
-        word_to_document_freqs_[*adress].erase(document_id);
+    if (!document_terms_.count(document_id)) { return; }
+    auto& document_terms = document_terms_.at(document_id);
+    std::vector <TermId> terms(document_terms.size());
+    std::transform(std::execution::par, document_terms.begin(), document_terms.end(), terms.begin(),
+        [](const DocumentTerm& document_term) {
+            return document_term.term;
+        });
+    std::for_each(std::execution::par, terms.begin(), terms.end(), [&](TermId term) {//каждое слово живёт в своём списке, поэтому списки можно чистить параллельно
+        term_postings_[term].Remove(document_id);
         });
-    id_to_word_freqs_.erase(document_id);//Из других мап удаляем с помощью erase
-    documents_.erase(document_id);
+    document_terms_.erase(document_id);//Из других мап удаляем с помощью erase
+    document_positions_.erase(document_id);
+    total_word_count_ -= columns_.WordCount(document_id);
+    columns_.Erase(document_id);
     document_ids_.erase(document_id);
+    ++generation_;
+}
+
+void SearchServer::SetPositionIndexing(bool enabled) {
+    if (!document_ids_.empty()) {
+        throw std::invalid_argument(std::string("Position indexing can only change while the server is empty"));
+    }
+    index_positions_ = enabled;
+}
+
+bool SearchServer::GetPositionIndexing() const {
+    return index_positions_;
+}
+
+void SearchServer::Compact(PostingFormat format) {
+    for (auto& postings : term_postings_) {
+        if (format == PostingFormat::COMPRESSED) {
+            postings.Compress([this](int document_id) {
+                return columns_.WordCount(document_id);
+            });
+        } else {
+            postings.Compact();
+        }
+    }
+}
+
+void SearchServer::SetResultCacheCapacity(size_t capacity) {
+    result_cache_ = capacity == 0 ? nullptr : std::make_unique<ResultCache>(capacity, RESULT_CACHE_SHARD_COUNT);
+}
+
+CacheStats SearchServer::GetResultCacheStats() const {
+    return result_cache_ ? result_cache_->GetStats() : CacheStats{};
+}
+
+size_t SearchServer::ResultCacheKeyHash::operator()(const ResultCacheKey& key) const {
+    uint64_t hash = key.generation * 0x9E3779B97F4A7C15ull;
+    const auto mix = [&hash](uint64_t value) {
+        hash = (hash ^ value) * 0x100000001B3ull;
+    };
+    mix(static_cast<uint64_t>(key.status));
+    mix(key.top_count);
+    for (const TermId term : key.query.plus_terms) {
+        mix(term);
+    }
+    mix(key.query.minus_terms.size());
+    for (const TermId term : key.query.minus_terms) {
+        mix(term);
+    }
+    for (const Phrase& phrase : key.query.phrases) {
+        mix(phrase.terms.size());
+        mix(static_cast<uint64_t>(phrase.slop));
+        for (const TermId term : phrase.terms) {
+            mix(term);
+        }
+    }
+    return static_cast<size_t>(hash ^ (hash >> 32));
+}
+
+SearchServer::IndexStats SearchServer::GetIndexStats() const {
+    IndexStats stats;
+    for (const auto& postings : term_postings_) {
+        stats.posting_count += postings.Size();
+        stats.posting_bytes += postings.MemoryUsage();
+    }
+    for (const auto& [document_id, positions] : document_positions_) {
+        stats.position_bytes += positions.MemoryUsage();
+    }
+    return stats;
+}
+
+void SearchServer::SaveSnapshot(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Cannot create " + path);
+    }
+    SnapshotWriter writer(out);
+    writer.WriteStrings(std::vector<std::string_view>(stop_words_.begin(), stop_words_.end()));
+
+    std::vector<std::string_view> words(terms_.Size());
+    for (TermId term = 0; term < words.size(); ++term) {
+        words[term] = terms_.GetTerm(term);
+    }
+    writer.WriteStrings(words);
+    for (const auto& postings : term_postings_) {
+        postings.Save(writer);
+    }
+
+    std::vector<int> ids;
+    std::vector<int> ratings;
+    std::vector<int> statuses;
+    std::vector<int> word_counts;
+    std::vector<uint64_t> word_freq_offsets{ 0 };
+    std::vector<TermId> word_freq_terms;
+    std::vector<double> word_freqs;
+    for (const int document_id : document_ids_) {
+        const DocumentData data = columns_.At(document_id);
+        ids.push_back(document_id);
+        ratings.push_back(data.rating);
+        statuses.push_back(static_cast<int>(data.status));
+        word_counts.push_back(data.word_count);
+        for (const auto& [term, term_freq] : document_terms_.at(document_id)) {
+            word_freq_terms.push_back(term);
+            word_freqs.push_back(term_freq);
+        }
+        word_freq_offsets.push_back(word_freq_terms.size());
+    }
+    writer.WriteArray<int>(ids);
+    writer.WriteArray<int>(ratings);
+    writer.WriteArray<int>(statuses);
+    writer.WriteArray<int>(word_counts);
+    writer.WriteArray<uint64_t>(word_freq_offsets);
+    writer.WriteArray<TermId>(word_freq_terms);
+    writer.WriteArray<double>(word_freqs);
+
+    writer.Write<uint8_t>(index_positions_);
+    if (index_positions_) {
+        std::vector<uint32_t> position_offsets;
+        std::vector<uint8_t> position_data;
+        for (const auto& [document_id, positions] : document_positions_) {
+            position_offsets.insert(position_offsets.end(), positions.Offsets().begin(), positions.Offsets().end());
+            position_data.insert(position_data.end(), positions.Data().begin(), positions.Data().end());
+        }
+        writer.WriteArray<uint32_t>(position_offsets);
+        writer.WriteArray<uint8_t>(position_data);
+    }
+    out.flush();
+    if (!out) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+}
+
+SearchServer SearchServer::LoadSnapshot(const std::string& path) {
+    auto snapshot = std::make_shared<const MappedFile>(path);
+    SnapshotReader reader(snapshot->Data(), snapshot->Size());
+    return SearchServer(std::move(snapshot), reader);
+}
+
+SearchServer::SearchServer(std::shared_ptr<const MappedFile> snapshot, SnapshotReader& reader)
+    : snapshot_(std::move(snapshot)), stop_words_(LoadStopWords(reader))
+    , stop_word_index_(std::vector<std::string_view>(stop_words_.begin(), stop_words_.end()))
+{
+    for (const auto word : reader.ReadStrings()) {
+        terms_.InternExternal(word);
+    }
+    term_postings_.resize(terms_.Size());
+    for (auto& postings : term_postings_) {
+        postings.Load(reader);
+    }
+
+    const auto ids = reader.ReadArray<int>();
+    const auto ratings = reader.ReadArray<int>();
+    const auto statuses = reader.ReadArray<int>();
+    const auto word_counts = reader.ReadArray<int>();
+    const auto word_freq_offsets = reader.ReadArray<uint64_t>();
+    const auto word_freq_terms = reader.ReadArray<TermId>();
+    const auto word_freqs = reader.ReadArray<double>();
+    if (ratings.size() != ids.size() || statuses.size() != ids.size() || word_counts.size() != ids.size()
+        || word_freq_offsets.size() != ids.size() + 1 || word_freqs.size() != word_freq_terms.size()
+        || word_freq_offsets.back() != word_freq_terms.size()) {
+        throw std::runtime_error(std::string("Corrupted snapshot"));
+    }
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (ids[i] < 0 || statuses[i] < 0 || statuses[i] >= static_cast<int>(DocumentColumns::STATUS_COUNT) || columns_.Contains(ids[i])) {
+            throw std::runtime_error(std::string("Corrupted snapshot"));
+        }
+        columns_.Insert(ids[i], DocumentData{ ratings[i], static_cast<DocumentStatus>(statuses[i]), word_counts[i] });
+        document_ids_.insert(document_ids_.end(), ids[i]);
+        total_word_count_ += word_counts[i];
+        if (word_freq_offsets[i] > word_freq_offsets[i + 1] || word_freq_offsets[i + 1] > word_freq_terms.size()) {
+            throw std::runtime_error(std::string("Corrupted snapshot"));
+        }
+        auto& document_terms = document_terms_[ids[i]];
+        document_terms.reserve(word_freq_offsets[i + 1] - word_freq_offsets[i]);
+        for (uint64_t pos = word_freq_offsets[i]; pos < word_freq_offsets[i + 1]; ++pos) {
+            if (word_freq_terms[pos] >= terms_.Size() || (!document_terms.empty() && document_terms.back().term >= word_freq_terms[pos])) {
+                throw std::runtime_error(std::string("Corrupted snapshot"));
+            }
+            document_terms.push_back({ word_freq_terms[pos], word_freqs[pos] });
+        }
+    }
+
+    // postings may only refer to loaded documents, whose columns are read unchecked while scoring
+    for (const auto& postings : term_postings_) {
+        postings.ForEach([this](int document_id, double) {
+            if (!columns_.Contains(document_id)) {
+                throw std::runtime_error(std::string("Corrupted snapshot"));
+            }
+        });
+    }
+
+    // every document has term count + 1 position offsets, relative to its own data
+    index_positions_ = reader.Read<uint8_t>() != 0;
+    if (index_positions_) {
+        const auto position_offsets = reader.ReadArray<uint32_t>();
+        const auto position_data = reader.ReadArray<uint8_t>();
+        size_t offsets_begin = 0;
+        size_t data_begin = 0;
+        for (const auto& [document_id, document_terms] : document_terms_) {
+            const size_t offsets_end = offsets_begin + document_terms.size() + 1;
+            if (offsets_end > position_offsets.size() || position_data.size() - data_begin < position_offsets[offsets_end - 1]) {
+                throw std::runtime_error(std::string("Corrupted snapshot"));
+            }
+            const size_t data_end = data_begin + position_offsets[offsets_end - 1];
+            try {
+                document_positions_.emplace_hint(document_positions_.end(), document_id, DocumentPositions(
+                    { position_offsets.begin() + offsets_begin, position_offsets.begin() + offsets_end },
+                    { position_data.begin() + data_begin, position_data.begin() + data_end }));
+            } catch (const std::invalid_argument&) {
+                throw std::runtime_error(std::string("Corrupted snapshot"));
+            }
+            offsets_begin = offsets_end;
+            data_begin = data_end;
+        }
+        if (offsets_begin != position_offsets.size() || data_begin != position_data.size()) {
+            throw std::runtime_error(std::string("Corrupted snapshot"));
+        }
+    }
+}
+
+std::set<std::string, std::less<>> SearchServer::LoadStopWords(SnapshotReader& reader) {
+    const auto words = reader.ReadStrings();
+    return { words.begin(), words.end() };
 }
 
 bool SearchServer::IsStopWord(const std::string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_word_index_.Contains(word);
 }
 
 bool SearchServer::IsValidWord(const std::string_view word) {
@@ -139,17 +799,14 @@ bool SearchServer::IsValidWord(const std::string_view word) {
         });
 }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view text) const {
-    std::vector<std::string_view> words;
-    for (const auto word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            throw std::invalid_argument(std::string("Word ") + std::string(word) + std::string(" is invalid"));
-        }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
-        }
+void SearchServer::SplitIntoWordsNoStop(const std::string_view text, std::vector<std::string_view>& words) const {
+    const size_t first_invalid = SplitIntoWords(text, words);
+    if (first_invalid < words.size()) {
+        throw std::invalid_argument(std::string("Word ") + std::string(words[first_invalid]) + std::string(" is invalid"));
     }
-    return words;
+    words.erase(std::remove_if(words.begin(), words.end(), [this](const std::string_view word) {
+        return IsStopWord(word);
+    }), words.end());
 }
 
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
@@ -177,48 +834,130 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string_view text
     return { word, is_minus, IsStopWord(word) };
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::string_view text) const {
-    Query result;
-    for (const std::string_view word : SplitIntoWords(text)) {
-        const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                result.minus_words.push_back(query_word.data);
-            }
-            else {
-                result.plus_words.push_back(query_word.data);
-            }
-        }
+SearchServer::Query SearchServer::ParseQuery(const std::string_view text, std::pmr::memory_resource* resource) const {
+    const QueryPhaseTimer timer(QueryPhase::PARSE);
+    Query result = ParseQueryPar(text, resource);
+    for (auto* terms : { &result.plus_terms, &result.minus_terms }) {
+        std::sort(terms->begin(), terms->end(), [this](TermId prev, TermId post) {
+            return terms_.GetTerm(prev) < terms_.GetTerm(post);
+            });
+        auto it_end = std::unique(terms->begin(), terms->end());
+        terms->erase(it_end, terms->end());
     }
-    std::sort(result.plus_words.begin(), result.plus_words.end(), [](auto prev, auto post) {
-        return prev < post;
-        });
-    auto it_end = std::unique(result.plus_words.begin(), result.plus_words.end());
-    result.plus_words.erase(it_end, result.plus_words.end());
-    std::sort(result.minus_words.begin(), result.minus_words.end(), [](auto prev, auto post) {
-        return prev < post;
-        });
-    it_end = std::unique(result.minus_words.begin(), result.minus_words.end());
-    result.minus_words.erase(it_end, result.minus_words.end());
     return result;
 }
 
-SearchServer::Query SearchServer::ParseQueryPar(const std::string_view text) const {
-    Query result;
-    for (const std::string_view word : SplitIntoWords(text)) {
-        const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                result.minus_words.push_back(query_word.data);
+SearchServer::Query SearchServer::ParseQueryPar(const std::string_view text, std::pmr::memory_resource* resource) const {
+    Query result(resource);
+    std::optional<Phrase> phrase;
+    std::pmr::vector<std::string_view> words(resource);
+    SplitIntoWords(text, words);
+    for (std::string_view word : words) {
+        if (!phrase && !word.empty() && word[0] == '"') {
+            phrase.emplace(Phrase{ std::pmr::vector<TermId>(resource) });
+            word.remove_prefix(1);
+        }
+        if (phrase) {
+            // a quote closes the phrase, optionally followed by ~slop
+            const size_t quote = word.find('"');
+            const std::string_view word_text = word.substr(0, quote);
+            if (!word_text.empty()) {
+                const auto query_word = ParseQueryWord(word_text);
+                if (query_word.is_minus) {
+                    throw std::invalid_argument(std::string("Query phrase word ") + std::string(word_text) + std::string(" is invalid"));
+                }
+                if (!query_word.is_stop) {
+                    const TermId term = terms_.Find(query_word.data);
+                    phrase->terms.push_back(term);
+                    if (term != TermDictionary::NO_TERM) {
+                        result.plus_terms.push_back(term);
+                    }
+                }
             }
-            else {
-                result.plus_words.push_back(query_word.data);
+            if (quote != std::string_view::npos) {
+                phrase->slop = ParsePhraseSlop(word.substr(quote + 1));
+                if (phrase->terms.size() > 1) {
+                    if (!index_positions_) {
+                        throw std::invalid_argument(std::string("Phrase queries need an index with word positions"));
+                    }
+                    result.phrases.push_back(std::move(*phrase));
+                }
+                phrase.reset();
             }
+            continue;
+        }
+        const auto query_word = ParseQueryWord(word);
+        if (query_word.is_stop) {
+            continue;
+        }
+        const TermId term = terms_.Find(query_word.data);
+        if (term == TermDictionary::NO_TERM) {
+            continue;
+        }
+        if (query_word.is_minus) {
+            result.minus_terms.push_back(term);
         }
+        else {
+            result.plus_terms.push_back(term);
+        }
+    }
+    if (phrase) {
+        throw std::invalid_argument(std::string("Query phrase is not closed"));
     }
     return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const {
-    return std::log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+int SearchServer::ParsePhraseSlop(const std::string_view text) {
+    if (text.empty()) {
+        return -1;
+    }
+    if (text.size() < 2 || text.size() > 10 || text[0] != '~'
+        || !std::all_of(text.begin() + 1, text.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        throw std::invalid_argument(std::string("Query phrase suffix ") + std::string(text) + std::string(" is invalid"));
+    }
+    const long long slop = std::stoll(std::string(text.substr(1)));
+    if (slop > INT32_MAX) {
+        throw std::invalid_argument(std::string("Query phrase suffix ") + std::string(text) + std::string(" is invalid"));
+    }
+    return static_cast<int>(slop);
+}
+
+double SearchServer::GetAverageWordCount() const {
+    return document_ids_.empty() ? 0.0 : total_word_count_ * 1.0 / document_ids_.size();
+}
+
+size_t SearchServer::FindDocumentTerm(const std::vector<DocumentTerm>& document_terms, TermId term) {
+    const auto it = std::lower_bound(document_terms.begin(), document_terms.end(), term, [](const DocumentTerm& document_term, TermId term) {
+        return document_term.term < term;
+    });
+    return it != document_terms.end() && it->term == term ? it - document_terms.begin() : document_terms.size();
+}
+
+bool SearchServer::MatchesPhrases(int document_id, std::span<const Phrase> phrases) const {
+    if (phrases.empty()) {
+        return true;
+    }
+    const auto& document_terms = document_terms_.at(document_id);
+    const auto& document_positions = document_positions_.at(document_id);
+    std::vector<size_t> term_indexes;
+    std::vector<std::vector<uint32_t>> positions;
+    for (const Phrase& phrase : phrases) {
+        // all the words must be there before any positions are decoded
+        term_indexes.clear();
+        for (const TermId term : phrase.terms) {
+            term_indexes.push_back(FindDocumentTerm(document_terms, term));
+            if (term_indexes.back() == document_terms.size()) {
+                return false;
+            }
+        }
+        positions.resize(phrase.terms.size());
+        for (size_t i = 0; i < term_indexes.size(); ++i) {
+            document_positions.Decode(term_indexes[i], positions[i]);
+        }
+        const bool is_match = phrase.slop < 0 ? HasPhrase(positions) : HasWindow(positions, static_cast<uint32_t>(phrase.slop));
+        if (!is_match) {
+            return false;
+        }
+    }
+    return true;
 }
@@ -1,33 +1,47 @@
 #pragma once
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <numeric>
 #include <set>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <utility>
 #include <vector>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <execution>
+#include <thread>
 #include "string_processing.h"
 #include "document.h"
+#include "document_columns.h"
 #include "log_duration.h"
-#include "concurrent_map.h"
+#include "perfect_hash_set.h"
+#include "lru_cache.h"
+#include "posting_list.h"
+#include "query_context.h"
+#include "scoring.h"
+#include "search_metrics.h"
+#include "snapshot.h"
+#include "term_dictionary.h"
+#include "top_documents.h"
+#include "word_positions.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
-enum class DocumentStatus {
-    ACTUAL,
-    IRRELEVANT,
-    BANNED,
-    REMOVED,
-};
 class SearchServer {
 public:
 
     template <typename StringContainer>
     explicit SearchServer(const StringContainer& stop_words)
         : stop_words_(MakeUniqueNonEmptyStrings(stop_words))  
+        , stop_word_index_(std::vector<std::string_view>(stop_words_.begin(), stop_words_.end()))
     {
         if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
             throw std::invalid_argument(std::string("Some of stop words are invalid"));
@@ -50,21 +64,82 @@ public:
 
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+    struct NewDocument {
+        int id;
+        std::string_view text;
+        DocumentStatus status;
+        std::vector<int> ratings;
+    };
+    // Adds the whole batch or, if any document is rejected, nothing. The parallel version tokenizes
+    // chunks of the batch concurrently and merges their partial indexes into the posting lists.
+    void AddDocuments(const std::vector<NewDocument>& documents);
+    void AddDocuments(const std::execution::sequenced_policy&, const std::vector<NewDocument>& documents);
+    void AddDocuments(const std::execution::parallel_policy&, const std::vector<NewDocument>& documents);
+    // Copies the documents of source for which keep(document_id) holds, with their ratings, statuses and
+    // exact term frequencies; nothing is tokenized again
+    template <typename Keep>
+    void ImportDocuments(const SearchServer& source, Keep keep);
+
+    // top_count limits the number of returned documents; MAX_RESULT_DOCUMENT_COUNT unless given
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const std::string_view raw_query,
-        DocumentPredicate document_predicate) const;
+        DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template <typename DocumentPredicate, typename PolicyType>
+        requires std::is_execution_policy_v<PolicyType>
     std::vector<Document> FindTopDocuments(const PolicyType& policy, const std::string_view raw_query,
-        DocumentPredicate document_predicate) const;
+        DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+        size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template <typename PolicyType>
-    std::vector<Document> FindTopDocuments(const PolicyType& policy, const std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+        requires std::is_execution_policy_v<PolicyType>
+    std::vector<Document> FindTopDocuments(const PolicyType& policy, const std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+        size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // The same searches ranked by another relevance model, e.g. Bm25Scoring{}; everything else uses TfIdfScoring.
+    // Their results are not cached.
+    template <ScoringModel Scoring, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const Scoring& scoring, const std::string_view raw_query,
+        DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template <typename PolicyType, ScoringModel Scoring, typename DocumentPredicate>
+        requires std::is_execution_policy_v<PolicyType>
+    std::vector<Document> FindTopDocuments(const PolicyType& policy, const Scoring& scoring, const std::string_view raw_query,
+        DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template <ScoringModel Scoring>
+    std::vector<Document> FindTopDocuments(const Scoring& scoring, const std::string_view raw_query,
+        DocumentStatus status = DocumentStatus::ACTUAL, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template <typename PolicyType, ScoringModel Scoring>
+        requires std::is_execution_policy_v<PolicyType>
+    std::vector<Document> FindTopDocuments(const PolicyType& policy, const Scoring& scoring, const std::string_view raw_query,
+        DocumentStatus status = DocumentStatus::ACTUAL, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // Answers every query as FindTopDocuments(raw_query, status, top_count) would. Queries are parsed in
+    // parallel and queries with the same words after parsing are evaluated once. Queries sharing a plus word
+    // with another one are scored together, reading the postings of each word once for all of them; the
+    // others run concurrently, each with WAND.
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+        DocumentStatus status = DocumentStatus::ACTUAL, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     int GetDocumentCount() const;
 
+    // Document count and plus word document frequencies a query is scored with. A partitioned index sums
+    // them over its parts and scores every part with the totals, so relevance matches a single index.
+    struct CorpusStats {
+        int document_count = 0;
+        std::map<std::string, int, std::less<>> document_freqs;
+    };
+    CorpusStats GetCorpusStats(const std::string_view raw_query) const;
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const CorpusStats& corpus_stats, const std::string_view raw_query,
+        DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(const CorpusStats& corpus_stats, const std::string_view raw_query,
+        DocumentStatus status = DocumentStatus::ACTUAL, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
     using MatchResult = std::tuple<std::vector<std::string_view>, DocumentStatus>;
     MatchResult MatchDocument(const std::string_view raw_query,
         int document_id) const;
@@ -72,164 +147,629 @@ public:
         int document_id) const;
     MatchResult MatchDocument(const std::execution::parallel_policy&, const std::string_view raw_query,
         int document_id) const;
+    // Matches one query against many documents, e.g. the results to highlight: the query is parsed once and
+    // the parallel version matches the documents concurrently. Results follow the order of document_ids.
+    std::vector<MatchResult> MatchDocuments(const std::string_view raw_query, std::span<const int> document_ids) const;
+    std::vector<MatchResult> MatchDocuments(const std::execution::sequenced_policy&, const std::string_view raw_query,
+        std::span<const int> document_ids) const;
+    std::vector<MatchResult> MatchDocuments(const std::execution::parallel_policy&, const std::string_view raw_query,
+        std::span<const int> document_ids) const;
+
+    struct DocumentTerm {
+        TermId term;
+        double term_freq;
+    };
+    // Read-only view of the (word, term frequency) pairs of a document in term id order. Nothing is copied,
+    // so any number of threads may read views at once; a view is valid while its document stays indexed.
+    class WordFrequencies {
+    public:
+        class Iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = std::pair<std::string_view, double>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = value_type;
+
+            Iterator() = default;
+            Iterator(const TermDictionary* terms, const DocumentTerm* pos)
+                : terms_(terms), pos_(pos) {
+            }
+
+            value_type operator*() const {
+                return { terms_->GetTerm(pos_->term), pos_->term_freq };
+            }
+            Iterator& operator++() {
+                ++pos_;
+                return *this;
+            }
+            Iterator operator++(int) {
+                Iterator old = *this;
+                ++pos_;
+                return old;
+            }
+            bool operator==(const Iterator& other) const {
+                return pos_ == other.pos_;
+            }
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+        private:
+            const TermDictionary* terms_ = nullptr;
+            const DocumentTerm* pos_ = nullptr;
+        };
+
+        WordFrequencies() = default;
+        WordFrequencies(const TermDictionary* terms, std::span<const DocumentTerm> document_terms)
+            : terms_(terms), document_terms_(document_terms) {
+        }
+
+        Iterator begin() const {
+            return { terms_, document_terms_.data() };
+        }
+        Iterator end() const {
+            return { terms_, document_terms_.data() + document_terms_.size() };
+        }
+        size_t size() const {
+            return document_terms_.size();
+        }
+        bool empty() const {
+            return document_terms_.empty();
+        }
+        std::span<const DocumentTerm> Terms() const {
+            return document_terms_;
+        }
+
+    private:
+        const TermDictionary* terms_ = nullptr;
+        std::span<const DocumentTerm> document_terms_;
+    };
+    // Empty for unknown documents
+    WordFrequencies GetWordFrequencies(int document_id) const;
     void RemoveDocument(int document_id);
     void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
     void RemoveDocument(const std::execution::parallel_policy&, int document_id);
 
-private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-        std::set <std::string, std::less<>> text;
+    // Documents added while enabled also store word positions, which phrase queries need: "big white cat"
+    // matches the words in this order one after another, "white cat"~2 matches them in any order within
+    // a window of 2 + 2 words (stop words are not counted). May only change while the server is empty.
+    void SetPositionIndexing(bool enabled);
+    bool GetPositionIndexing() const;
+
+    // Folds the deltas left by AddDocument/RemoveDocument into the posting lists, re-encoding them in format
+    void Compact(PostingFormat format = PostingFormat::PLAIN);
+
+    struct IndexStats {
+        size_t posting_count = 0;
+        size_t posting_bytes = 0;
+        size_t position_bytes = 0;
     };
-    std::map <int, std::map <std::string_view, double>> id_to_word_freqs_;
+    IndexStats GetIndexStats() const;
+
+    // Results of status queries (not of custom predicates) are cached by their parsed words when capacity is
+    // non-zero. Every AddDocument/RemoveDocument starts a new index generation, retiring all cached results.
+    void SetResultCacheCapacity(size_t capacity);
+    CacheStats GetResultCacheStats() const;
+
+    // Writes the whole server state to a versioned binary snapshot
+    void SaveSnapshot(const std::string& path) const;
+    // Maps a snapshot read-only. Word texts and compressed postings are used in place, so the file must not
+    // change while the server lives; Compact(PostingFormat::COMPRESSED) before saving keeps startup cheapest.
+    static SearchServer LoadSnapshot(const std::string& path);
+
+private:
+    std::shared_ptr<const MappedFile> snapshot_;
+    // forward index: the terms of every document sorted by term id
+    std::map<int, std::vector<DocumentTerm>> document_terms_;
+    bool index_positions_ = false;
+    std::map<int, DocumentPositions> document_positions_;
     const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, DocumentData> documents_;
+    PerfectHashSet stop_word_index_;
+    TermDictionary terms_;
+    std::vector<PostingList> term_postings_;
+    DocumentColumns columns_;
+    int64_t total_word_count_ = 0;
     std::set<int> document_ids_;
+    uint64_t generation_ = 0;
+
+    // the generation is part of the key, so results of older index states are never found and age out
+    struct Phrase {
+        std::pmr::vector<TermId> terms;
+        // -1 for an exact phrase, otherwise the extra words allowed in an unordered window
+        int slop = -1;
+
+        auto operator<=>(const Phrase&) const = default;
+    };
+    // Query words resolved to term ids; words missing from the index are dropped after validation
+    // (phrases keep them as NO_TERM, which makes the phrase unmatchable).
+    // Queries of the search hot path live in the thread's QueryArena, copies go to the default resource.
+    struct Query {
+        explicit Query(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+            : plus_terms(resource)
+            , minus_terms(resource)
+            , phrases(resource) {
+        }
+
+        std::pmr::vector<TermId> plus_terms;
+        std::pmr::vector<TermId> minus_terms;
+        std::pmr::vector<Phrase> phrases;
+
+        auto operator<=>(const Query&) const = default;
+    };
+
+    struct ResultCacheKey {
+        uint64_t generation;
+        Query query;
+        DocumentStatus status;
+        size_t top_count;
+
+        bool operator==(const ResultCacheKey&) const = default;
+    };
+    struct ResultCacheKeyHash {
+        size_t operator()(const ResultCacheKey& key) const;
+    };
+    using ResultCache = ConcurrentLruCache<ResultCacheKey, std::vector<Document>, ResultCacheKeyHash>;
+    static constexpr size_t RESULT_CACHE_SHARD_COUNT = 16;
+    std::unique_ptr<ResultCache> result_cache_;
+
+    SearchServer(std::shared_ptr<const MappedFile> snapshot, SnapshotReader& reader);
+    static std::set<std::string, std::less<>> LoadStopWords(SnapshotReader& reader);
 
     bool IsStopWord(const std::string_view word) const;
     static bool IsValidWord(const std::string_view word);
-    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view text) const;
+    // Fills words (capacity reused) with the words of text that are not stop words
+    void SplitIntoWordsNoStop(const std::string_view text, std::vector<std::string_view>& words) const;
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    template <typename PolicyType>
+    void AddDocumentsBatch(const PolicyType& policy, const std::vector<NewDocument>& documents);
+
+    // Predicate of the status overloads; FindDocumentsInRange recognizes it and tests the status bitsets instead
+    struct StatusPredicate {
+        DocumentStatus status;
+
+        bool operator()(int, DocumentStatus document_status, int) const {
+            return document_status == status;
+        }
+    };
+
     struct QueryWord {
         std::string_view data;
         bool is_minus;
         bool is_stop;
     };
     QueryWord ParseQueryWord(const std::string_view text) const;
-    struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
-    };
-    Query ParseQuery(const std::string_view text) const;
-    Query ParseQueryPar(const std::string_view text) const;
+    // Phrase words are plus words too. Plus and minus terms are deduplicated and ordered by their words
+    Query ParseQuery(const std::string_view text, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+    Query ParseQueryPar(const std::string_view text, std::pmr::memory_resource* resource) const;
+    // "" for an exact phrase, "~slop" for a window
+    static int ParsePhraseSlop(const std::string_view text);
 
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    double GetAverageWordCount() const;
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query,
-        DocumentPredicate document_predicate) const;
+    // Allocated from the resource of its query, whose phrases it refers to
+    struct QueryPostings {
+        struct PlusWord {
+            const PostingList* postings;
+            double inverse_document_freq;
+        };
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query,
-        DocumentPredicate document_predicate) const;
+        explicit QueryPostings(std::pmr::memory_resource* resource)
+            : plus_words(resource)
+            , minus_postings(resource) {
+        }
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query,
-        DocumentPredicate document_predicate) const;
+        std::pmr::vector<PlusWord> plus_words;
+        std::pmr::vector<const PostingList*> minus_postings;
+        std::span<const Phrase> phrases;
+        double average_word_count = 0.0;
+    };
+    // Inverse document frequencies come from corpus_stats when given, from this index otherwise
+    template <typename Scoring>
+    QueryPostings FindQueryPostings(const Scoring& scoring, const Query& query, const CorpusStats* corpus_stats = nullptr) const;
+    // Index of term in the document's term vector, or the vector size if the document lacks it
+    static size_t FindDocumentTerm(const std::vector<DocumentTerm>& document_terms, TermId term);
+    // True if the document holds every phrase; positions are decoded here, for candidates only
+    bool MatchesPhrases(int document_id, std::span<const Phrase> phrases) const;
+    // Throws std::out_of_range for unknown documents
+    MatchResult MatchQuery(const Query& query, int document_id) const;
+    template <typename PolicyType>
+    std::vector<MatchResult> MatchDocumentsBatch(const PolicyType& policy, const std::string_view raw_query,
+        std::span<const int> document_ids) const;
+
+    template <typename Scoring, typename DocumentPredicate>
+    void FindDocumentsInRange(const Scoring& scoring, const QueryPostings& query_postings, int64_t range_begin, int64_t range_end,
+        DocumentPredicate& document_predicate, TopDocuments& top_documents) const;
+
+    // FindAllDocuments return at most top_count matched documents ordered best-first
+    template <typename Scoring, typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Scoring& scoring, const QueryPostings& query_postings,
+        DocumentPredicate document_predicate, size_t top_count) const;
+
+    template <typename Scoring, typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Scoring& scoring, const QueryPostings& query_postings,
+        DocumentPredicate document_predicate, size_t top_count) const;
+    // Term-at-a-time TF-IDF scoring of several queries over blocks of docids, every posting list read once
+    // for all the queries holding its word. Returns what FindAllDocuments returns for each query.
+    std::vector<std::vector<Document>> FindAllDocumentsShared(std::span<const Query* const> queries, DocumentStatus status,
+        size_t top_count) const;
 };
 
 
 
 
 
+template <typename Keep>
+void SearchServer::ImportDocuments(const SearchServer& source, Keep keep) {
+    for (const int document_id : source.document_ids_) {
+        if (!keep(document_id)) {
+            continue;
+        }
+        const DocumentData data = source.columns_.At(document_id);
+        if (columns_.Contains(document_id)) {
+            throw std::invalid_argument(std::string("Document with your id has exist yet"));
+        }
+        if (index_positions_ && source.document_positions_.count(document_id) == 0) {
+            throw std::invalid_argument(std::string("Imported documents have no word positions"));
+        }
+        auto& document_terms = document_terms_[document_id];
+        for (const auto& [source_term, term_freq] : source.document_terms_.at(document_id)) {
+            document_terms.push_back({ terms_.Intern(source.terms_.GetTerm(source_term)), term_freq });
+        }
+        std::sort(document_terms.begin(), document_terms.end(), [](const DocumentTerm& lhs, const DocumentTerm& rhs) {
+            return lhs.term < rhs.term;
+        });
+        if (term_postings_.size() < terms_.Size()) {
+            term_postings_.resize(terms_.Size());
+        }
+        for (const auto& [term, term_freq] : document_terms) {
+            term_postings_[term].Add(document_id, term_freq);
+        }
+        if (index_positions_) {
+            // the word sequence is rebuilt from the source positions, then regrouped by this server's term ids
+            const auto& source_positions = source.document_positions_.at(document_id);
+            const auto& source_terms = source.document_terms_.at(document_id);
+            std::vector<TermId> word_terms(data.word_count);
+            std::vector<uint32_t> positions;
+            for (size_t i = 0; i < source_terms.size(); ++i) {
+                source_positions.Decode(i, positions);
+                const TermId term = terms_.Find(source.terms_.GetTerm(source_terms[i].term));
+                for (const uint32_t position : positions) {
+                    word_terms.at(position) = term;
+                }
+            }
+            document_positions_.emplace(document_id, DocumentPositions(word_terms));
+        }
+        columns_.Insert(document_id, data);
+        document_ids_.insert(document_id);
+        total_word_count_ += data.word_count;
+    }
+    ++generation_;
+}
+
 template <typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query,
-    DocumentPredicate document_predicate) const {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+    DocumentPredicate document_predicate, size_t top_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, top_count);
 }
 
 template <typename DocumentPredicate, typename PolicyType>
+    requires std::is_execution_policy_v<PolicyType>
 std::vector<Document> SearchServer::FindTopDocuments(const PolicyType& policy, const std::string_view raw_query,
-    DocumentPredicate document_predicate) const {
+    DocumentPredicate document_predicate, size_t top_count) const {
     //LOG_DURATION_STREAM(std::string("Operation time"), std::cout);
-    const auto query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-    std::sort(policy, matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < std::numeric_limits<double>::epsilon()) {
-                return lhs.rating > rhs.rating;
-            }
-            else {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-    return matched_documents;
+    return FindTopDocuments(policy, TfIdfScoring{}, raw_query, document_predicate, top_count);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const CorpusStats& corpus_stats, const std::string_view raw_query,
+    DocumentPredicate document_predicate, size_t top_count) const {
+    const QueryScope scope;
+    const auto query = ParseQuery(raw_query, &scope.Arena());
+    const TfIdfScoring scoring;
+    return FindAllDocuments(std::execution::seq, scoring, FindQueryPostings(scoring, query, &corpus_stats), document_predicate, top_count);
 }
 
 template <typename PolicyType>
-std::vector<Document> SearchServer::FindTopDocuments(const PolicyType& policy, const std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy,
-        raw_query, [status](int document_id, DocumentStatus document_status = DocumentStatus::ACTUAL, int rating) {
-            return document_status == status;
-        });
+    requires std::is_execution_policy_v<PolicyType>
+std::vector<Document> SearchServer::FindTopDocuments(const PolicyType& policy, const std::string_view raw_query, DocumentStatus status,
+    size_t top_count) const {
+    const QueryScope scope;
+    const auto query = ParseQuery(raw_query, &scope.Arena());
+    const StatusPredicate document_predicate{ status };
+    const TfIdfScoring scoring;
+    if (!result_cache_) {
+        return FindAllDocuments(policy, scoring, FindQueryPostings(scoring, query), document_predicate, top_count);
+    }
+    const ResultCacheKey key{ generation_, query, status, top_count };
+    if (auto documents = result_cache_->Find(key)) {
+        return std::move(*documents);
+    }
+    auto documents = FindAllDocuments(policy, scoring, FindQueryPostings(scoring, query), document_predicate, top_count);
+    result_cache_->Insert(key, documents);
+    return documents;
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query,
-    DocumentPredicate document_predicate) const {
-    size_t bucket_count = 100;
-    ConcurrentMap <int, double> document_to_relevance(bucket_count);
-    std::for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(), [&](const std::string_view word) {
-        if (word_to_document_freqs_.count(word)) {
-
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            std::for_each(std::execution::par, word_to_document_freqs_.at(word).begin(), word_to_document_freqs_.at(word).end(), [&](const auto id_freq) {
-                const auto& document_data = documents_.at(id_freq.first);
-                if (document_predicate(id_freq.first, document_data.status, document_data.rating)) {
-                    document_to_relevance[id_freq.first].ref_to_value += id_freq.second * inverse_document_freq;
-                }
-                });
+template <ScoringModel Scoring, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const Scoring& scoring, const std::string_view raw_query,
+    DocumentPredicate document_predicate, size_t top_count) const {
+    return FindTopDocuments(std::execution::seq, scoring, raw_query, document_predicate, top_count);
+}
+
+template <typename PolicyType, ScoringModel Scoring, typename DocumentPredicate>
+    requires std::is_execution_policy_v<PolicyType>
+std::vector<Document> SearchServer::FindTopDocuments(const PolicyType& policy, const Scoring& scoring, const std::string_view raw_query,
+    DocumentPredicate document_predicate, size_t top_count) const {
+    const QueryScope scope;
+    const auto query = ParseQuery(raw_query, &scope.Arena());
+    return FindAllDocuments(policy, scoring, FindQueryPostings(scoring, query), document_predicate, top_count);
+}
+
+template <ScoringModel Scoring>
+std::vector<Document> SearchServer::FindTopDocuments(const Scoring& scoring, const std::string_view raw_query,
+    DocumentStatus status, size_t top_count) const {
+    return FindTopDocuments(std::execution::seq, scoring, raw_query, status, top_count);
+}
+
+template <typename PolicyType, ScoringModel Scoring>
+    requires std::is_execution_policy_v<PolicyType>
+std::vector<Document> SearchServer::FindTopDocuments(const PolicyType& policy, const Scoring& scoring, const std::string_view raw_query,
+    DocumentStatus status, size_t top_count) const {
+    return FindTopDocuments(policy, scoring, raw_query, StatusPredicate{ status }, top_count);
+}
+
+template <typename Scoring>
+SearchServer::QueryPostings SearchServer::FindQueryPostings(const Scoring& scoring, const Query& query, const CorpusStats* corpus_stats) const {
+    QueryPostings result(query.plus_terms.get_allocator().resource());
+    result.average_word_count = GetAverageWordCount();
+    for (const TermId term : query.plus_terms) {
+        if (corpus_stats == nullptr) {
+            result.plus_words.push_back({ &term_postings_[term],
+                scoring.InverseDocumentFreq(GetDocumentCount(), static_cast<int>(term_postings_[term].Size())) });
+            continue;
+        }
+        const auto freq_it = corpus_stats->document_freqs.find(terms_.GetTerm(term));
+        if (freq_it == corpus_stats->document_freqs.end()) {
+            throw std::invalid_argument(std::string("Corpus stats miss a query word"));
         }
+        result.plus_words.push_back({ &term_postings_[term], scoring.InverseDocumentFreq(corpus_stats->document_count, freq_it->second) });
+    }
+    for (const TermId term : query.minus_terms) {
+        result.minus_postings.push_back(&term_postings_[term]);
+    }
+    result.phrases = query.phrases;
+    const bool has_unknown_phrase_word = std::any_of(query.phrases.begin(), query.phrases.end(), [](const Phrase& phrase) {
+        return std::count(phrase.terms.begin(), phrase.terms.end(), TermDictionary::NO_TERM) > 0;
+    });
+    if (has_unknown_phrase_word) {
+        result.plus_words.clear();
+    }
+    return result;
+}
+
+template <typename Scoring, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Scoring& scoring, const QueryPostings& query_postings,
+    DocumentPredicate document_predicate, size_t top_count) const {
+    AddQueryCounter(QueryCounter::QUERIES, 1);
+    if (document_ids_.empty()) {
+        return {};
+    }
+    const QueryScope scope;
+    QueryArena& arena = scope.Arena();
+    // every part scores its own docid range, so no state is shared between threads
+    const int64_t min_id = *document_ids_.begin();
+    const int64_t id_span = static_cast<int64_t>(*document_ids_.rbegin()) - min_id + 1;
+    const int64_t part_count = std::min<int64_t>(id_span, std::max(1u, std::thread::hardware_concurrency()));
+    std::pmr::vector<TopDocuments> part_tops(&arena);
+    part_tops.reserve(part_count);
+    for (int64_t part = 0; part < part_count; ++part) {
+        part_tops.emplace_back(top_count, &arena);
+    }
+    std::pmr::vector<int64_t> parts(part_count, &arena);
+    std::iota(parts.begin(), parts.end(), 0);
+    {
+        const QueryPhaseTimer timer(QueryPhase::POSTINGS);
+        std::for_each(std::execution::par, parts.begin(), parts.end(), [&](int64_t part) {
+            FindDocumentsInRange(scoring, query_postings, min_id + id_span * part / part_count, min_id + id_span * (part + 1) / part_count,
+                document_predicate, part_tops[part]);
         });
-    std::for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(), [&](const std::string_view word) {
-        if (word_to_document_freqs_.count(word)) {
+    }
+    const QueryPhaseTimer timer(QueryPhase::TOP_K);
+    TopDocuments top_documents(top_count, &arena);
+    for (auto& part_top : part_tops) {
+        for (const Document& document : part_top.Extract()) {
+            top_documents.Push(document);
+        }
+    }
+    return top_documents.Extract();
+}
 
-            std::for_each(std::execution::par, word_to_document_freqs_.at(word).begin(), word_to_document_freqs_.at(word).end(), [&](const auto id_smthng) {
-                document_to_relevance.Erase(id_smthng.first);
-                });
+template <typename Scoring, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Scoring& scoring, const QueryPostings& query_postings,
+    DocumentPredicate document_predicate, size_t top_count) const {
+    AddQueryCounter(QueryCounter::QUERIES, 1);
+    if (document_ids_.empty()) {
+        return {};
+    }
+    const QueryScope scope;
+    TopDocuments top_documents(top_count, &scope.Arena());
+    {
+        const QueryPhaseTimer timer(QueryPhase::POSTINGS);
+        FindDocumentsInRange(scoring, query_postings, *document_ids_.begin(), static_cast<int64_t>(*document_ids_.rbegin()) + 1,
+            document_predicate, top_documents);
+    }
+    const QueryPhaseTimer timer(QueryPhase::TOP_K);
+    return top_documents.Extract();
+}
+
+// Document-at-a-time WAND: a document is scored only if the upper bounds of the words it may contain
+// can still beat the current top_documents threshold; block maxima then skip whole posting blocks.
+template <typename Scoring, typename DocumentPredicate>
+void SearchServer::FindDocumentsInRange(const Scoring& scoring, const QueryPostings& query_postings, int64_t range_begin, int64_t range_end,
+    DocumentPredicate& document_predicate, TopDocuments& top_documents) const {
+    constexpr bool IS_STATUS_QUERY = std::is_same_v<std::remove_cv_t<DocumentPredicate>, StatusPredicate>;
+    // parts of parallel queries run on other threads, which use their own arenas
+    const QueryScope scope;
+    QueryArena& arena = scope.Arena();
+    const auto& plus_words = query_postings.plus_words;
+    const size_t word_count = plus_words.size();
+    std::pmr::vector<PostingList::Cursor> cursors(&arena);
+    std::pmr::vector<double> upper_bounds(&arena);
+    cursors.reserve(word_count);
+    upper_bounds.reserve(word_count);
+    for (const auto& plus_word : plus_words) {
+        cursors.emplace_back(*plus_word.postings, &arena).SkipTo(static_cast<int>(range_begin));
+        upper_bounds.push_back(scoring.MaxTermScore(plus_word.postings->MaxTermFreq(), query_postings.average_word_count,
+            plus_word.inverse_document_freq));
+    }
+    // frequent minus words exclude through their bitmaps, the rest through cursors
+    std::pmr::vector<const DocIdBitmap*> minus_bitmaps(&arena);
+    std::pmr::vector<PostingList::Cursor> minus_cursors(&arena);
+    minus_cursors.reserve(query_postings.minus_postings.size());
+    for (const PostingList* postings : query_postings.minus_postings) {
+        if (postings->Bitmap() != nullptr) {
+            minus_bitmaps.push_back(postings->Bitmap());
+        } else {
+            minus_cursors.emplace_back(*postings, &arena).SkipTo(static_cast<int>(range_begin));
         }
+    }
+    // the first docid from document_id on that is in none of the minus bitmaps
+    const auto next_allowed_id = [&minus_bitmaps](int64_t document_id) {
+        for (bool is_moved = true; is_moved;) {
+            is_moved = false;
+            for (const DocIdBitmap* bitmap : minus_bitmaps) {
+                const int64_t next_id = bitmap->NextAbsent(document_id);
+                is_moved = is_moved || next_id != document_id;
+                document_id = next_id;
+            }
+        }
+        return document_id;
+    };
+    std::pmr::vector<bool> exhausted(word_count, false, &arena);
+    const auto current_id = [&](size_t word) {
+        if (exhausted[word] || cursors[word].IsEnd() || cursors[word].DocumentId() >= range_end) {
+            return range_end;
+        }
+        return static_cast<int64_t>(cursors[word].DocumentId());
+    };
+    const auto skip_to = [&](size_t word, int64_t document_id) {
+        if (document_id >= range_end) {
+            exhausted[word] = true;
+        } else {
+            cursors[word].SkipTo(static_cast<int>(document_id));
+        }
+    };
+    // documents within epsilon of the threshold may still win on rating, rounding gets a little slack too
+    const auto can_enter = [](double bound, double threshold) {
+        return bound + std::numeric_limits<double>::epsilon() + 1e-12 * std::abs(bound) >= threshold;
+    };
+
+    // the filter and minus word checks are interleaved with the traversal, so their times are sampled
+    QueryPhaseSampler sampler;
+    uint64_t postings_scanned = 0;
+    uint64_t documents_scored = 0;
+
+    std::pmr::vector<size_t> order(word_count, &arena);
+    std::iota(order.begin(), order.end(), 0);
+    while (true) {
+        std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+            return current_id(lhs) < current_id(rhs);
         });
-    auto doc_to_rel = std::move(document_to_relevance.BuildOrdinaryMap());
-    std::vector<Document> matched_documents;
-    std::for_each(std::execution::par, doc_to_rel.begin(), doc_to_rel.end(), [&](const auto id_rel) {
-        matched_documents.push_back(
-            { id_rel.first, id_rel.second, documents_.at(id_rel.first).rating });
-        });
-    return matched_documents;
-}
+        const double threshold = top_documents.Threshold();
+        double bound = 0.0;
+        size_t pivot = word_count;
+        for (size_t i = 0; i < word_count && current_id(order[i]) < range_end; ++i) {
+            bound += upper_bounds[order[i]];
+            if (can_enter(bound, threshold)) {
+                pivot = i;
+                break;
+            }
+        }
+        if (pivot == word_count) {
+            break;
+        }
+        const int64_t pivot_id = current_id(order[pivot]);
+        if (current_id(order[0]) != pivot_id) {
+            for (size_t i = 0; i < pivot; ++i) {
+                skip_to(order[i], pivot_id);
+            }
+            continue;
+        }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query,
-    DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
-    for (const std::string_view word : query.plus_words) {
-        if (!word_to_document_freqs_.count(word)) {
+        size_t last = pivot;
+        while (last + 1 < word_count && current_id(order[last + 1]) == pivot_id) {
+            ++last;
+        }
+        double block_bound = 0.0;
+        int64_t next_id = last + 1 < word_count ? current_id(order[last + 1]) : range_end;
+        for (size_t i = 0; i <= last; ++i) {
+            const auto& cursor = cursors[order[i]];
+            block_bound += scoring.MaxTermScore(cursor.BlockMaxTermFreq(), query_postings.average_word_count,
+                plus_words[order[i]].inverse_document_freq);
+            next_id = std::min<int64_t>(next_id, static_cast<int64_t>(cursor.BlockLastDocumentId()) + 1);
+        }
+        if (!can_enter(block_bound, threshold)) {
+            for (size_t i = 0; i <= last; ++i) {
+                skip_to(order[i], next_id);
+            }
             continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+
+        const int document_id = static_cast<int>(pivot_id);
+        sampler.NextIteration();
+        // a run of documents excluded by frequent minus words is skipped at once, none of it is scored
+        if (!minus_bitmaps.empty()) {
+            sampler.Start();
+            const int64_t allowed_id = next_allowed_id(pivot_id);
+            sampler.Stop(QueryPhase::MINUS_WORDS);
+            if (allowed_id != pivot_id) {
+                for (size_t i = 0; i <= last; ++i) {
+                    skip_to(order[i], allowed_id);
+                }
+                continue;
+            }
+        }
+        // status queries check the status bitset before anything else, filtered out documents are never scored
+        bool is_rejected = false;
+        if constexpr (IS_STATUS_QUERY) {
+            sampler.Start();
+            is_rejected = !columns_.HasStatus(document_id, document_predicate.status);
+            sampler.Stop(QueryPhase::FILTER);
+        }
+        if (!is_rejected && !minus_cursors.empty()) {
+            sampler.Start();
+            is_rejected = std::any_of(minus_cursors.begin(), minus_cursors.end(), [document_id](auto& cursor) {
+                cursor.SkipTo(document_id);
+                return !cursor.IsEnd() && cursor.DocumentId() == document_id;
+            });
+            sampler.Stop(QueryPhase::MINUS_WORDS);
+        }
+        documents_scored += is_rejected ? 0 : 1;
+        const double length_norm = is_rejected ? 0.0
+            : scoring.LengthNorm(columns_.WordCount(document_id), query_postings.average_word_count);
+        // summing in query word order keeps relevance bit-identical to term-at-a-time scoring
+        double relevance = 0.0;
+        for (size_t word = 0; word < word_count; ++word) {
+            if (current_id(word) == pivot_id) {
+                if (!is_rejected) {
+                    relevance += scoring.TermScore(cursors[word].TermFreq(), length_norm, plus_words[word].inverse_document_freq);
+                }
+                cursors[word].Next();
+                ++postings_scanned;
             }
         }
-    }
-    for (const std::string_view word : query.minus_words) {
-        if (!word_to_document_freqs_.count(word)) {
+        if (is_rejected || !MatchesPhrases(document_id, query_postings.phrases)) {
             continue;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+        const int rating = columns_.Rating(document_id);
+        if constexpr (!IS_STATUS_QUERY) {
+            sampler.Start();
+            const bool is_kept = document_predicate(document_id, columns_.Status(document_id), rating);
+            sampler.Stop(QueryPhase::FILTER);
+            if (!is_kept) {
+                continue;
+            }
         }
+        top_documents.Push({ document_id, relevance, rating });
     }
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back(
-            { document_id, relevance, documents_.at(document_id).rating });
-    }
-    return matched_documents;
+    AddQueryCounter(QueryCounter::POSTINGS_SCANNED, postings_scanned);
+    AddQueryCounter(QueryCounter::DOCUMENTS_SCORED, documents_scored);
 }
-
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query,
-    DocumentPredicate document_predicate) const {
-    return FindAllDocuments(std::execution::seq, query, document_predicate);
-}
\ No newline at end of file
@@ -0,0 +1,261 @@
+#include "segmented_search_server.h"
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+SegmentedSearchServer::Segment::Segment(SearchServer segment_index)
+    : index(std::move(segment_index)) {
+    index.Compact(PostingFormat::COMPRESSED);
+    document_ids.assign(index.begin(), index.end());
+    tombstones.assign((document_ids.size() + 63) / 64, 0);
+}
+
+size_t SegmentedSearchServer::Segment::GetLiveCount() const {
+    return document_ids.size() - removed_count;
+}
+
+bool SegmentedSearchServer::Segment::IsLive(int document_id) const {
+    const auto it = std::lower_bound(document_ids.begin(), document_ids.end(), document_id);
+    if (it == document_ids.end() || *it != document_id) {
+        return false;
+    }
+    const size_t ordinal = it - document_ids.begin();
+    return (tombstones[ordinal / 64] >> (ordinal % 64) & 1) == 0;
+}
+
+bool SegmentedSearchServer::Segment::Remove(int document_id) {
+    if (!IsLive(document_id)) {
+        return false;
+    }
+    const size_t ordinal = std::lower_bound(document_ids.begin(), document_ids.end(), document_id) - document_ids.begin();
+    tombstones[ordinal / 64] |= uint64_t{ 1 } << (ordinal % 64);
+    ++removed_count;
+    for (const auto& [word, term_freq] : index.GetWordFrequencies(document_id)) {
+        ++removed_document_freqs[std::string(word)];
+    }
+    return true;
+}
+
+SegmentedSearchServer::SegmentedSearchServer(const std::string_view stop_words_text, size_t flush_threshold, size_t merge_factor)
+    : stop_words_text_(stop_words_text)
+    , flush_threshold_(std::max<size_t>(1, flush_threshold))
+    , merge_factor_(std::max<size_t>(2, merge_factor))
+    , write_segment_(std::make_unique<SearchServer>(stop_words_text))
+    , merge_thread_(&SegmentedSearchServer::MergeLoop, this) {
+}
+
+SegmentedSearchServer::~SegmentedSearchServer() {
+    {
+        std::lock_guard guard(segments_mutex_);
+        stopping_ = true;
+    }
+    merge_cv_.notify_all();
+    merge_thread_.join();
+}
+
+void SegmentedSearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    const auto segments = GetSegments();
+    if (std::any_of(segments.begin(), segments.end(), [document_id](const auto& segment) { return segment->IsLive(document_id); })) {
+        throw std::invalid_argument(std::string("Document with your id has exist yet"));
+    }
+    write_segment_->AddDocument(document_id, document, status, ratings);
+    if (static_cast<size_t>(write_segment_->GetDocumentCount()) >= flush_threshold_) {
+        Flush();
+    }
+}
+
+void SegmentedSearchServer::RemoveDocument(int document_id) {
+    {
+        std::lock_guard guard(segments_mutex_);
+        for (const auto& segment : segments_) {
+            if (segment->Remove(document_id)) {
+                merge_requested_ = merge_requested_ || segment->removed_count * 2 > segment->document_ids.size();
+                break;
+            }
+        }
+    }
+    write_segment_->RemoveDocument(document_id);
+    merge_cv_.notify_all();
+}
+
+int SegmentedSearchServer::GetDocumentCount() const {
+    int count = write_segment_->GetDocumentCount();
+    for (const auto& segment : GetSegments()) {
+        count += static_cast<int>(segment->GetLiveCount());
+    }
+    return count;
+}
+
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status,
+    size_t top_count) const {
+    // segments are searched by status, which their indexes filter through the status bitsets; a segment's
+    // removed documents are dropped afterwards, so it is asked for as many more results as it has tombstones
+    const auto segments = GetSegments();
+    const SearchServer::CorpusStats corpus_stats = GetCorpusStats(segments, raw_query);
+    TopDocuments top_documents(top_count);
+    for (const Document& document : write_segment_->FindTopDocuments(corpus_stats, raw_query, status, top_count)) {
+        top_documents.Push(document);
+    }
+    for (const auto& segment : segments) {
+        for (const Document& document : segment->index.FindTopDocuments(corpus_stats, raw_query, status, top_count + segment->removed_count)) {
+            if (segment->IsLive(document.id)) {
+                top_documents.Push(document);
+            }
+        }
+    }
+    return top_documents.Extract();
+}
+
+SearchServer::MatchResult SegmentedSearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
+    for (const auto& segment : GetSegments()) {
+        if (segment->IsLive(document_id)) {
+            return segment->index.MatchDocument(raw_query, document_id);
+        }
+    }
+    return write_segment_->MatchDocument(raw_query, document_id);
+}
+
+void SegmentedSearchServer::Flush() {
+    if (write_segment_->GetDocumentCount() == 0) {
+        return;
+    }
+    auto segment = std::make_shared<Segment>(std::move(*write_segment_));
+    write_segment_ = std::make_unique<SearchServer>(stop_words_text_);
+    {
+        std::lock_guard guard(segments_mutex_);
+        segments_.push_back(std::move(segment));
+        merge_requested_ = true;
+    }
+    merge_cv_.notify_all();
+}
+
+void SegmentedSearchServer::WaitForMerges() {
+    std::unique_lock lock(segments_mutex_);
+    merge_cv_.wait(lock, [this] {
+        return !merge_requested_ && !merging_;
+    });
+}
+
+size_t SegmentedSearchServer::GetSegmentCount() const {
+    std::lock_guard guard(segments_mutex_);
+    return segments_.size();
+}
+
+std::vector<std::shared_ptr<SegmentedSearchServer::Segment>> SegmentedSearchServer::GetSegments() const {
+    std::lock_guard guard(segments_mutex_);
+    return segments_;
+}
+
+SearchServer::CorpusStats SegmentedSearchServer::GetCorpusStats(const std::vector<std::shared_ptr<Segment>>& segments,
+    const std::string_view raw_query) const {
+    SearchServer::CorpusStats corpus_stats = write_segment_->GetCorpusStats(raw_query);
+    for (const auto& segment : segments) {
+        const auto segment_stats = segment->index.GetCorpusStats(raw_query);
+        corpus_stats.document_count += static_cast<int>(segment->GetLiveCount());
+        for (const auto& [word, document_freq] : segment_stats.document_freqs) {
+            const auto removed_it = segment->removed_document_freqs.find(word);
+            const int removed = removed_it == segment->removed_document_freqs.end() ? 0 : removed_it->second;
+            corpus_stats.document_freqs[word] += document_freq - removed;
+        }
+    }
+    return corpus_stats;
+}
+
+size_t SegmentedSearchServer::GetTier(const Segment& segment) const {
+    size_t tier = 0;
+    for (size_t size = flush_threshold_ * merge_factor_; size <= segment.GetLiveCount(); size *= merge_factor_) {
+        ++tier;
+    }
+    return tier;
+}
+
+std::vector<std::shared_ptr<SegmentedSearchServer::Segment>> SegmentedSearchServer::PlanMerge() const {
+    // a segment that is mostly tombstones is rewritten on its own
+    for (const auto& segment : segments_) {
+        if (segment->removed_count * 2 > segment->document_ids.size()) {
+            return { segment };
+        }
+    }
+    std::map<size_t, std::vector<std::shared_ptr<Segment>>> tiers;
+    for (const auto& segment : segments_) {
+        auto& tier = tiers[GetTier(*segment)];
+        tier.push_back(segment);
+        if (tier.size() == merge_factor_) {
+            return tier;
+        }
+    }
+    return {};
+}
+
+void SegmentedSearchServer::MergeLoop() {
+    std::unique_lock lock(segments_mutex_);
+    while (true) {
+        merge_cv_.wait(lock, [this] {
+            return stopping_ || merge_requested_;
+        });
+        if (stopping_) {
+            return;
+        }
+        merge_requested_ = false;
+        const auto inputs = PlanMerge();
+        if (inputs.empty()) {
+            merge_cv_.notify_all();
+            continue;
+        }
+        std::vector<std::vector<uint64_t>> input_tombstones;
+        for (const auto& input : inputs) {
+            input_tombstones.push_back(input->tombstones);
+        }
+        merging_ = true;
+        lock.unlock();
+
+        std::shared_ptr<Segment> merged;
+        try {
+            // input indexes are immutable, only their tombstones change, and those were copied above
+            SearchServer merged_index(stop_words_text_);
+            for (size_t i = 0; i < inputs.size(); ++i) {
+                const Segment& input = *inputs[i];
+                const auto& tombstones = input_tombstones[i];
+                merged_index.ImportDocuments(input.index, [&input, &tombstones](int document_id) {
+                    const size_t ordinal = std::lower_bound(input.document_ids.begin(), input.document_ids.end(), document_id)
+                        - input.document_ids.begin();
+                    return (tombstones[ordinal / 64] >> (ordinal % 64) & 1) == 0;
+                });
+            }
+            merged = std::make_shared<Segment>(std::move(merged_index));
+        } catch (...) {
+            // a failed merge leaves its inputs in place; they are planned again on the next request
+        }
+
+        lock.lock();
+        if (merged != nullptr) {
+            try {
+                // documents removed while merging are removed from the merged segment too
+                for (size_t i = 0; i < inputs.size(); ++i) {
+                    const Segment& input = *inputs[i];
+                    for (size_t word = 0; word < input.tombstones.size(); ++word) {
+                        for (uint64_t removed = input.tombstones[word] & ~input_tombstones[i][word]; removed != 0; removed &= removed - 1) {
+                            merged->Remove(input.document_ids[word * 64 + std::countr_zero(removed)]);
+                        }
+                    }
+                }
+            } catch (...) {
+                merged = nullptr;
+            }
+        }
+        if (merged == nullptr) {
+            merging_ = false;
+            merge_cv_.notify_all();
+            continue;
+        }
+        const auto first_input = std::find(segments_.begin(), segments_.end(), inputs.front());
+        *first_input = merged->GetLiveCount() > 0 ? merged : nullptr;
+        segments_.erase(std::remove_if(segments_.begin(), segments_.end(), [&inputs](const auto& segment) {
+            return segment == nullptr || std::find(inputs.begin() + 1, inputs.end(), segment) != inputs.end();
+        }), segments_.end());
+        merging_ = false;
+        // the new segment may complete another tier
+        merge_requested_ = true;
+        merge_cv_.notify_all();
+    }
+}
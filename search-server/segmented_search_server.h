@@ -0,0 +1,109 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "document.h"
+#include "search_server.h"
+#include "top_documents.h"
+
+// Log-structured index. Documents go to a small mutable write segment; once it holds flush_threshold
+// documents it is compacted into an immutable segment. Removing a document from an immutable segment only
+// sets its bit in the segment's tombstone bitmap. A background thread merges segments of the same size tier
+// (merge_factor of them whose live sizes are within a factor of merge_factor) and rewrites segments that are
+// mostly tombstones; a merge that throws leaves its input segments in place. Queries search all segments with
+// corpus statistics over the live documents, so results are those of a single index.
+// Like SearchServer, updates must not overlap queries; only the background merging runs concurrently.
+class SegmentedSearchServer {
+public:
+    static constexpr size_t DEFAULT_FLUSH_THRESHOLD = 4096;
+    static constexpr size_t DEFAULT_MERGE_FACTOR = 4;
+
+    explicit SegmentedSearchServer(const std::string_view stop_words_text,
+        size_t flush_threshold = DEFAULT_FLUSH_THRESHOLD, size_t merge_factor = DEFAULT_MERGE_FACTOR);
+    SegmentedSearchServer(const SegmentedSearchServer&) = delete;
+    SegmentedSearchServer& operator=(const SegmentedSearchServer&) = delete;
+    ~SegmentedSearchServer();
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+    int GetDocumentCount() const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query,
+        DocumentPredicate document_predicate, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+        size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    SearchServer::MatchResult MatchDocument(const std::string_view raw_query, int document_id) const;
+
+    // Turns the write segment into an immutable one
+    void Flush();
+    // Blocks until the background thread has no merge left to do
+    void WaitForMerges();
+    // Immutable segments, the write segment not included
+    size_t GetSegmentCount() const;
+
+private:
+    struct Segment {
+        explicit Segment(SearchServer segment_index);
+
+        SearchServer index;
+        std::vector<int> document_ids;
+        std::vector<uint64_t> tombstones;
+        // number of removed documents containing a word, subtracted from the segment's document frequencies
+        std::map<std::string, int, std::less<>> removed_document_freqs;
+        size_t removed_count = 0;
+
+        size_t GetLiveCount() const;
+        // Returns false for documents the segment doesn't hold
+        bool IsLive(int document_id) const;
+        // Returns false if the document isn't live in the segment
+        bool Remove(int document_id);
+    };
+
+    const std::string stop_words_text_;
+    const size_t flush_threshold_;
+    const size_t merge_factor_;
+    std::unique_ptr<SearchServer> write_segment_;
+    // guards the segment list and the tombstones against the merging thread
+    mutable std::mutex segments_mutex_;
+    std::vector<std::shared_ptr<Segment>> segments_;
+    std::condition_variable merge_cv_;
+    bool merge_requested_ = false;
+    bool merging_ = false;
+    bool stopping_ = false;
+    std::thread merge_thread_;
+
+    std::vector<std::shared_ptr<Segment>> GetSegments() const;
+    SearchServer::CorpusStats GetCorpusStats(const std::vector<std::shared_ptr<Segment>>& segments, const std::string_view raw_query) const;
+    size_t GetTier(const Segment& segment) const;
+    // Picks segments to merge; empty if there's nothing to do
+    std::vector<std::shared_ptr<Segment>> PlanMerge() const;
+    void MergeLoop();
+};
+
+template <typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(const std::string_view raw_query,
+    DocumentPredicate document_predicate, size_t top_count) const {
+    const auto segments = GetSegments();
+    const SearchServer::CorpusStats corpus_stats = GetCorpusStats(segments, raw_query);
+    TopDocuments top_documents(top_count);
+    for (const Document& document : write_segment_->FindTopDocuments(corpus_stats, raw_query, document_predicate, top_count)) {
+        top_documents.Push(document);
+    }
+    for (const auto& segment : segments) {
+        const auto live_document_predicate = [&segment, &document_predicate](int document_id, DocumentStatus status, int rating) {
+            return segment->IsLive(document_id) && document_predicate(document_id, status, rating);
+        };
+        for (const Document& document : segment->index.FindTopDocuments(corpus_stats, raw_query, live_document_predicate, top_count)) {
+            top_documents.Push(document);
+        }
+    }
+    return top_documents.Extract();
+}
@@ -0,0 +1,475 @@
+#include "sharded_search_server.h"
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <execution>
+#include <numeric>
+#include <stdexcept>
+#include "top_documents.h"
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+LocalShard::LocalShard(const std::string_view stop_words_text)
+    : server_(stop_words_text) {
+}
+
+void LocalShard::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    server_.AddDocument(document_id, document, status, ratings);
+}
+
+void LocalShard::RemoveDocument(int document_id) {
+    server_.RemoveDocument(document_id);
+}
+
+int LocalShard::GetDocumentCount() const {
+    return server_.GetDocumentCount();
+}
+
+SearchServer::CorpusStats LocalShard::GetCorpusStats(const std::string_view raw_query) const {
+    return server_.GetCorpusStats(raw_query);
+}
+
+std::vector<Document> LocalShard::FindTopDocuments(const SearchServer::CorpusStats& corpus_stats, const std::string_view raw_query,
+    DocumentStatus status, size_t top_count) const {
+    return server_.FindTopDocuments(corpus_stats, raw_query, status, top_count);
+}
+
+SearchServer::MatchResult LocalShard::MatchDocument(const std::string_view raw_query, int document_id) const {
+    return server_.MatchDocument(raw_query, document_id);
+}
+
+#ifndef _WIN32
+namespace {
+enum class ShardCommand : uint8_t {
+    ADD_DOCUMENT,
+    REMOVE_DOCUMENT,
+    GET_DOCUMENT_COUNT,
+    GET_CORPUS_STATS,
+    FIND_TOP_DOCUMENTS,
+    MATCH_DOCUMENT,
+    STOP,
+};
+
+enum class ShardReply : uint8_t {
+    OK,
+    INVALID_ARGUMENT,
+    OUT_OF_RANGE,
+    FAILURE,
+};
+
+// Messages are plain byte strings in native byte order: both ends run on the same machine
+class MessageWriter {
+public:
+    template <typename T>
+    MessageWriter& Put(const T& value) {
+        data_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        return *this;
+    }
+
+    MessageWriter& PutString(std::string_view str) {
+        Put(static_cast<uint64_t>(str.size()));
+        data_.append(str);
+        return *this;
+    }
+
+    MessageWriter& PutCorpusStats(const SearchServer::CorpusStats& corpus_stats) {
+        Put(corpus_stats.document_count);
+        Put(static_cast<uint64_t>(corpus_stats.document_freqs.size()));
+        for (const auto& [word, document_freq] : corpus_stats.document_freqs) {
+            PutString(word);
+            Put(document_freq);
+        }
+        return *this;
+    }
+
+    const std::string& Data() const {
+        return data_;
+    }
+
+private:
+    std::string data_;
+};
+
+class MessageReader {
+public:
+    explicit MessageReader(std::string_view data)
+        : data_(data) {
+    }
+
+    template <typename T>
+    T Get() {
+        T value;
+        std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    std::string_view GetString() {
+        const uint64_t size = Get<uint64_t>();
+        return { Take(size), static_cast<size_t>(size) };
+    }
+
+    SearchServer::CorpusStats GetCorpusStats() {
+        SearchServer::CorpusStats corpus_stats;
+        corpus_stats.document_count = Get<int>();
+        for (uint64_t i = Get<uint64_t>(); i > 0; --i) {
+            const auto word = GetString();
+            corpus_stats.document_freqs.emplace(word, Get<int>());
+        }
+        return corpus_stats;
+    }
+
+private:
+    std::string_view data_;
+
+    const char* Take(uint64_t size) {
+        if (size > data_.size()) {
+            throw std::runtime_error(std::string("Malformed shard message"));
+        }
+        const char* bytes = data_.data();
+        data_.remove_prefix(static_cast<size_t>(size));
+        return bytes;
+    }
+};
+
+void SendAll(int socket, const char* data, size_t size) {
+    while (size > 0) {
+        const ssize_t sent = send(socket, data, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            throw std::runtime_error(std::string("Shard connection is broken"));
+        }
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+}
+
+// Returns false if the peer hung up before the first byte
+bool ReceiveAll(int socket, char* data, size_t size) {
+    for (size_t received_total = 0; received_total < size;) {
+        const ssize_t received = recv(socket, data + received_total, size - received_total, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received == 0 && received_total == 0) {
+            return false;
+        }
+        if (received <= 0) {
+            throw std::runtime_error(std::string("Shard connection is broken"));
+        }
+        received_total += static_cast<size_t>(received);
+    }
+    return true;
+}
+
+void SendMessage(int socket, const std::string& message) {
+    const uint64_t size = message.size();
+    SendAll(socket, reinterpret_cast<const char*>(&size), sizeof(size));
+    SendAll(socket, message.data(), message.size());
+}
+
+bool ReceiveMessage(int socket, std::string& message) {
+    uint64_t size = 0;
+    if (!ReceiveAll(socket, reinterpret_cast<char*>(&size), sizeof(size))) {
+        return false;
+    }
+    message.resize(static_cast<size_t>(size));
+    if (size > 0 && !ReceiveAll(socket, message.data(), message.size())) {
+        throw std::runtime_error(std::string("Shard connection is broken"));
+    }
+    return true;
+}
+
+std::string ServeRequest(SearchServer& server, std::string_view request, bool& stop) {
+    MessageReader reader(request);
+    MessageWriter reply;
+    reply.Put(ShardReply::OK);
+    switch (reader.Get<ShardCommand>()) {
+    case ShardCommand::ADD_DOCUMENT: {
+        const int document_id = reader.Get<int>();
+        const auto document = reader.GetString();
+        const auto status = reader.Get<DocumentStatus>();
+        std::vector<int> ratings(reader.Get<uint64_t>());
+        for (int& rating : ratings) {
+            rating = reader.Get<int>();
+        }
+        server.AddDocument(document_id, document, status, ratings);
+        break;
+    }
+    case ShardCommand::REMOVE_DOCUMENT:
+        server.RemoveDocument(reader.Get<int>());
+        break;
+    case ShardCommand::GET_DOCUMENT_COUNT:
+        reply.Put(server.GetDocumentCount());
+        break;
+    case ShardCommand::GET_CORPUS_STATS:
+        reply.PutCorpusStats(server.GetCorpusStats(reader.GetString()));
+        break;
+    case ShardCommand::FIND_TOP_DOCUMENTS: {
+        const auto corpus_stats = reader.GetCorpusStats();
+        const auto raw_query = reader.GetString();
+        const auto status = reader.Get<DocumentStatus>();
+        const auto top_count = reader.Get<uint64_t>();
+        const auto documents = server.FindTopDocuments(corpus_stats, raw_query, status, static_cast<size_t>(top_count));
+        reply.Put(static_cast<uint64_t>(documents.size()));
+        for (const Document& document : documents) {
+            reply.Put(document.id).Put(document.relevance).Put(document.rating);
+        }
+        break;
+    }
+    case ShardCommand::MATCH_DOCUMENT: {
+        const auto raw_query = reader.GetString();
+        const auto [words, status] = server.MatchDocument(raw_query, reader.Get<int>());
+        reply.Put(static_cast<uint64_t>(words.size()));
+        for (const auto word : words) {
+            reply.PutString(word);
+        }
+        reply.Put(status);
+        break;
+    }
+    case ShardCommand::STOP:
+        stop = true;
+        break;
+    default:
+        throw std::runtime_error(std::string("Unknown shard command"));
+    }
+    return reply.Data();
+}
+}
+
+RemoteShard::RemoteShard(int socket, int worker_pid)
+    : socket_(socket), worker_pid_(worker_pid) {
+}
+
+RemoteShard::~RemoteShard() {
+    try {
+        Call(MessageWriter().Put(ShardCommand::STOP).Data());
+    } catch (const std::exception&) {
+        // the worker is gone already
+    }
+    close(socket_);
+    if (worker_pid_ >= 0) {
+        waitpid(worker_pid_, nullptr, 0);
+    }
+}
+
+void RemoteShard::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    MessageWriter request;
+    request.Put(ShardCommand::ADD_DOCUMENT).Put(document_id).PutString(document).Put(status);
+    request.Put(static_cast<uint64_t>(ratings.size()));
+    for (const int rating : ratings) {
+        request.Put(rating);
+    }
+    Call(request.Data());
+}
+
+void RemoteShard::RemoveDocument(int document_id) {
+    Call(MessageWriter().Put(ShardCommand::REMOVE_DOCUMENT).Put(document_id).Data());
+}
+
+int RemoteShard::GetDocumentCount() const {
+    const std::string reply = Call(MessageWriter().Put(ShardCommand::GET_DOCUMENT_COUNT).Data());
+    return MessageReader(reply).Get<int>();
+}
+
+SearchServer::CorpusStats RemoteShard::GetCorpusStats(const std::string_view raw_query) const {
+    const std::string reply = Call(MessageWriter().Put(ShardCommand::GET_CORPUS_STATS).PutString(raw_query).Data());
+    return MessageReader(reply).GetCorpusStats();
+}
+
+std::vector<Document> RemoteShard::FindTopDocuments(const SearchServer::CorpusStats& corpus_stats, const std::string_view raw_query,
+    DocumentStatus status, size_t top_count) const {
+    MessageWriter request;
+    request.Put(ShardCommand::FIND_TOP_DOCUMENTS).PutCorpusStats(corpus_stats).PutString(raw_query).Put(status);
+    request.Put(static_cast<uint64_t>(top_count));
+    const std::string reply = Call(request.Data());
+    MessageReader reader(reply);
+    std::vector<Document> documents(reader.Get<uint64_t>());
+    for (Document& document : documents) {
+        document.id = reader.Get<int>();
+        document.relevance = reader.Get<double>();
+        document.rating = reader.Get<int>();
+    }
+    return documents;
+}
+
+SearchServer::MatchResult RemoteShard::MatchDocument(const std::string_view raw_query, int document_id) const {
+    const std::string reply = Call(MessageWriter().Put(ShardCommand::MATCH_DOCUMENT).PutString(raw_query).Put(document_id).Data());
+    MessageReader reader(reply);
+    std::vector<std::string_view> words(reader.Get<uint64_t>());
+    std::lock_guard guard(mutex_);
+    for (auto& word : words) {
+        word = words_.GetTerm(words_.Intern(reader.GetString()));
+    }
+    return { words, reader.Get<DocumentStatus>() };
+}
+
+std::string RemoteShard::Call(const std::string& request) const {
+    std::string reply;
+    {
+        std::lock_guard guard(mutex_);
+        SendMessage(socket_, request);
+        if (!ReceiveMessage(socket_, reply)) {
+            throw std::runtime_error(std::string("Shard worker hung up"));
+        }
+    }
+    MessageReader reader(reply);
+    const auto status = reader.Get<ShardReply>();
+    if (status == ShardReply::OK) {
+        return reply.substr(sizeof(ShardReply));
+    }
+    const std::string message(reader.GetString());
+    if (status == ShardReply::INVALID_ARGUMENT) {
+        throw std::invalid_argument(message);
+    }
+    if (status == ShardReply::OUT_OF_RANGE) {
+        throw std::out_of_range(message);
+    }
+    throw std::runtime_error(message);
+}
+
+void ServeShard(SearchServer& server, int socket) {
+    std::string request;
+    bool stop = false;
+    while (!stop && ReceiveMessage(socket, request)) {
+        std::string reply;
+        try {
+            reply = ServeRequest(server, request, stop);
+        } catch (const std::invalid_argument& e) {
+            reply = MessageWriter().Put(ShardReply::INVALID_ARGUMENT).PutString(e.what()).Data();
+        } catch (const std::out_of_range& e) {
+            reply = MessageWriter().Put(ShardReply::OUT_OF_RANGE).PutString(e.what()).Data();
+        } catch (const std::exception& e) {
+            reply = MessageWriter().Put(ShardReply::FAILURE).PutString(e.what()).Data();
+        }
+        SendMessage(socket, reply);
+    }
+}
+
+std::unique_ptr<SearchShard> StartShardProcess(const std::string_view stop_words_text) {
+    // invalid stop words are reported here rather than by a dead worker
+    SearchServer validated(stop_words_text);
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+        throw std::runtime_error(std::string("Cannot create a shard socket"));
+    }
+    const pid_t pid = fork();
+    if (pid < 0) {
+        close(sockets[0]);
+        close(sockets[1]);
+        throw std::runtime_error(std::string("Cannot start a shard worker"));
+    }
+    if (pid == 0) {
+        close(sockets[0]);
+        int exit_code = 0;
+        try {
+            ServeShard(validated, sockets[1]);
+        } catch (const std::exception&) {
+            exit_code = 1;
+        }
+        _exit(exit_code);
+    }
+    close(sockets[1]);
+    return std::make_unique<RemoteShard>(sockets[0], pid);
+}
+#endif
+
+ShardedSearchServer::ShardedSearchServer(std::vector<std::unique_ptr<SearchShard>> shards)
+    : shards_(std::move(shards)) {
+    if (shards_.empty()) {
+        throw std::invalid_argument(std::string("Sharded server needs at least one shard"));
+    }
+}
+
+ShardedSearchServer::ShardedSearchServer(const std::string_view stop_words_text, size_t shard_count) {
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(std::make_unique<LocalShard>(stop_words_text));
+    }
+    if (shards_.empty()) {
+        throw std::invalid_argument(std::string("Sharded server needs at least one shard"));
+    }
+}
+
+void ShardedSearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    if (document_id < 0) {
+        throw std::invalid_argument(std::string("Invalid document_id"));
+    }
+    GetShard(document_id).AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    if (document_id >= 0) {
+        GetShard(document_id).RemoveDocument(document_id);
+    }
+}
+
+template <typename Func>
+void ShardedSearchServer::ForEachShard(Func func) const {
+    // exceptions must not escape a parallel algorithm, the first one is rethrown afterwards
+    std::vector<std::exception_ptr> errors(shards_.size());
+    std::vector<size_t> indexes(shards_.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t index) {
+        try {
+            func(index, *shards_[index]);
+        } catch (...) {
+            errors[index] = std::current_exception();
+        }
+    });
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    std::vector<int> counts(shards_.size());
+    ForEachShard([&counts](size_t index, const SearchShard& shard) {
+        counts[index] = shard.GetDocumentCount();
+    });
+    return std::accumulate(counts.begin(), counts.end(), 0);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status,
+    size_t top_count) const {
+    std::vector<SearchServer::CorpusStats> shard_stats(shards_.size());
+    ForEachShard([&](size_t index, const SearchShard& shard) {
+        shard_stats[index] = shard.GetCorpusStats(raw_query);
+    });
+    SearchServer::CorpusStats corpus_stats;
+    for (const auto& stats : shard_stats) {
+        corpus_stats.document_count += stats.document_count;
+        for (const auto& [word, document_freq] : stats.document_freqs) {
+            corpus_stats.document_freqs[word] += document_freq;
+        }
+    }
+
+    std::vector<std::vector<Document>> shard_tops(shards_.size());
+    ForEachShard([&](size_t index, const SearchShard& shard) {
+        shard_tops[index] = shard.FindTopDocuments(corpus_stats, raw_query, status, top_count);
+    });
+    TopDocuments top_documents(top_count);
+    for (const auto& shard_top : shard_tops) {
+        for (const Document& document : shard_top) {
+            top_documents.Push(document);
+        }
+    }
+    return top_documents.Extract();
+}
+
+SearchServer::MatchResult ShardedSearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
+    if (document_id < 0) {
+        throw std::out_of_range(std::string("No document with id ") + std::to_string(document_id));
+    }
+    return GetShard(document_id).MatchDocument(raw_query, document_id);
+}
+
+SearchShard& ShardedSearchServer::GetShard(int document_id) const {
+    return *shards_[static_cast<size_t>(document_id) % shards_.size()];
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "document.h"
+#include "search_server.h"
+#include "term_dictionary.h"
+
+// One partition of a ShardedSearchServer
+class SearchShard {
+public:
+    virtual ~SearchShard() = default;
+
+    virtual void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) = 0;
+    virtual void RemoveDocument(int document_id) = 0;
+    virtual int GetDocumentCount() const = 0;
+    virtual SearchServer::CorpusStats GetCorpusStats(const std::string_view raw_query) const = 0;
+    virtual std::vector<Document> FindTopDocuments(const SearchServer::CorpusStats& corpus_stats, const std::string_view raw_query,
+        DocumentStatus status, size_t top_count) const = 0;
+    virtual SearchServer::MatchResult MatchDocument(const std::string_view raw_query, int document_id) const = 0;
+};
+
+// Shard living in the calling process
+class LocalShard : public SearchShard {
+public:
+    explicit LocalShard(const std::string_view stop_words_text);
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) override;
+    void RemoveDocument(int document_id) override;
+    int GetDocumentCount() const override;
+    SearchServer::CorpusStats GetCorpusStats(const std::string_view raw_query) const override;
+    std::vector<Document> FindTopDocuments(const SearchServer::CorpusStats& corpus_stats, const std::string_view raw_query,
+        DocumentStatus status, size_t top_count) const override;
+    SearchServer::MatchResult MatchDocument(const std::string_view raw_query, int document_id) const override;
+
+private:
+    SearchServer server_;
+};
+
+#ifndef _WIN32
+// Shard served by another process over a stream socket, ServeShard being the other end.
+// Calls to one shard are serialized; errors thrown by the worker are rethrown with their message.
+class RemoteShard : public SearchShard {
+public:
+    // Takes ownership of socket; a worker_pid >= 0 is waited for on destruction
+    explicit RemoteShard(int socket, int worker_pid = -1);
+    RemoteShard(const RemoteShard&) = delete;
+    RemoteShard& operator=(const RemoteShard&) = delete;
+    ~RemoteShard() override;
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) override;
+    void RemoveDocument(int document_id) override;
+    int GetDocumentCount() const override;
+    SearchServer::CorpusStats GetCorpusStats(const std::string_view raw_query) const override;
+    std::vector<Document> FindTopDocuments(const SearchServer::CorpusStats& corpus_stats, const std::string_view raw_query,
+        DocumentStatus status, size_t top_count) const override;
+    SearchServer::MatchResult MatchDocument(const std::string_view raw_query, int document_id) const override;
+
+private:
+    int socket_;
+    int worker_pid_;
+    mutable std::mutex mutex_;
+    // matched words are interned, so the string_views MatchDocument returns stay valid
+    mutable TermDictionary words_;
+
+    std::string Call(const std::string& request) const;
+};
+
+// Answers RemoteShard requests arriving on socket until the client stops the worker or hangs up
+void ServeShard(SearchServer& server, int socket);
+
+// Forks a worker process serving an empty shard. The child keeps only the calling thread,
+// so workers are best started before the parent runs parallel algorithms.
+std::unique_ptr<SearchShard> StartShardProcess(const std::string_view stop_words_text);
+#endif
+
+// Partitions documents by id over shards (id modulo shard count). Queries are fanned out to all shards
+// in parallel and their top documents merged; every shard scores with document frequencies summed over
+// all shards, so relevance is the one a single index holding every document would compute.
+class ShardedSearchServer {
+public:
+    explicit ShardedSearchServer(std::vector<std::unique_ptr<SearchShard>> shards);
+    ShardedSearchServer(const std::string_view stop_words_text, size_t shard_count);
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+    int GetDocumentCount() const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+        size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    // Only the shard owning the document is asked
+    SearchServer::MatchResult MatchDocument(const std::string_view raw_query, int document_id) const;
+
+private:
+    std::vector<std::unique_ptr<SearchShard>> shards_;
+
+    SearchShard& GetShard(int document_id) const;
+    template <typename Func>
+    void ForEachShard(Func func) const;
+};
@@ -0,0 +1,155 @@
+#include "snapshot.h"
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr uint64_t SNAPSHOT_MAGIC = 0x50414e5348435253ull;   // "SRCHSNAP" on little-endian machines
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+}
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path) {
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER size;
+    if (file_ == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_, &size)) {
+        if (file_ != INVALID_HANDLE_VALUE) {
+            CloseHandle(file_);
+        }
+        throw std::runtime_error("Cannot open " + path);
+    }
+    size_ = static_cast<size_t>(size.QuadPart);
+    mapping_ = size_ == 0 ? nullptr : CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    data_ = mapping_ == nullptr ? nullptr : static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (data_ == nullptr) {
+        if (mapping_ != nullptr) {
+            CloseHandle(mapping_);
+        }
+        CloseHandle(file_);
+        throw std::runtime_error("Cannot map " + path);
+    }
+}
+
+MappedFile::~MappedFile() {
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+}
+#else
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        throw std::runtime_error("Cannot open " + path);
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    void* data = size_ == 0 ? MAP_FAILED : mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping keeps the file referenced on its own
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Cannot map " + path);
+    }
+    data_ = static_cast<const uint8_t*>(data);
+}
+
+MappedFile::~MappedFile() {
+    munmap(const_cast<uint8_t*>(data_), size_);
+}
+#endif
+
+const uint8_t* MappedFile::Data() const {
+    return data_;
+}
+
+size_t MappedFile::Size() const {
+    return size_;
+}
+
+SnapshotWriter::SnapshotWriter(std::ostream& out)
+    : out_(out) {
+    Write(SNAPSHOT_MAGIC);
+    Write(SNAPSHOT_VERSION);
+    Write(BYTE_ORDER_MARK);
+}
+
+void SnapshotWriter::WriteStrings(const std::vector<std::string_view>& strings) {
+    std::vector<uint64_t> offsets;
+    offsets.reserve(strings.size() + 1);
+    offsets.push_back(0);
+    for (const auto str : strings) {
+        offsets.push_back(offsets.back() + str.size());
+    }
+    WriteArray<uint64_t>(offsets);
+    Write(offsets.back());
+    Align();
+    for (const auto str : strings) {
+        WriteBytes(str.data(), str.size());
+    }
+}
+
+void SnapshotWriter::WriteBytes(const void* data, size_t size) {
+    out_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    if (!out_) {
+        throw std::runtime_error(std::string("Cannot write snapshot"));
+    }
+    offset_ += size;
+}
+
+void SnapshotWriter::Align() {
+    static const char zeros[8] = {};
+    WriteBytes(zeros, (8 - offset_ % 8) % 8);
+}
+
+SnapshotReader::SnapshotReader(const uint8_t* data, size_t size)
+    : data_(data), size_(size) {
+    if (size_ < sizeof(SNAPSHOT_MAGIC) || Read<uint64_t>() != SNAPSHOT_MAGIC) {
+        throw std::runtime_error(std::string("Not a search server snapshot"));
+    }
+    if (Read<uint32_t>() != SNAPSHOT_VERSION) {
+        throw std::runtime_error(std::string("Unsupported snapshot version"));
+    }
+    if (Read<uint32_t>() != BYTE_ORDER_MARK) {
+        throw std::runtime_error(std::string("Snapshot was written with another byte order"));
+    }
+}
+
+std::vector<std::string_view> SnapshotReader::ReadStrings() {
+    const auto offsets = ReadArray<uint64_t>();
+    const uint64_t chars_size = Read<uint64_t>();
+    Align();
+    if (offsets.empty() || offsets.back() != chars_size) {
+        throw std::runtime_error(std::string("Corrupted snapshot"));
+    }
+    const char* chars = reinterpret_cast<const char*>(ReadBytes(chars_size));
+    std::vector<std::string_view> strings;
+    strings.reserve(offsets.size() - 1);
+    for (size_t i = 0; i + 1 < offsets.size(); ++i) {
+        if (offsets[i] > offsets[i + 1]) {
+            throw std::runtime_error(std::string("Corrupted snapshot"));
+        }
+        strings.emplace_back(chars + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    return strings;
+}
+
+const uint8_t* SnapshotReader::ReadBytes(size_t size) {
+    if (size > size_ - offset_) {
+        throw std::runtime_error(std::string("Truncated snapshot"));
+    }
+    const uint8_t* bytes = data_ + offset_;
+    offset_ += size;
+    return bytes;
+}
+
+void SnapshotReader::Align() {
+    ReadBytes((8 - offset_ % 8) % 8);
+}
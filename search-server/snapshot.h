@@ -0,0 +1,107 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+constexpr uint32_t SNAPSHOT_VERSION = 2;
+
+// Read-only mapping of a whole file. The pages are shared with every process mapping the same file.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const uint8_t* Data() const;
+    size_t Size() const;
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
+
+// Writes a versioned snapshot sequentially. Values are stored in native byte order and every array
+// starts at an 8-byte boundary, so SnapshotReader can hand it out in place.
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(std::ostream& out);
+
+    template <typename T>
+    void Write(const T& value);
+    template <typename T>
+    void WriteArray(std::span<const T> values);
+    void WriteStrings(const std::vector<std::string_view>& strings);
+
+private:
+    std::ostream& out_;
+    uint64_t offset_ = 0;
+
+    void WriteBytes(const void* data, size_t size);
+    void Align();
+};
+
+// Reads what SnapshotWriter wrote from memory that outlives the reader; arrays and strings point into it.
+// Throws std::runtime_error on a foreign, outdated or truncated snapshot.
+class SnapshotReader {
+public:
+    SnapshotReader(const uint8_t* data, size_t size);
+
+    template <typename T>
+    T Read();
+    template <typename T>
+    std::span<const T> ReadArray();
+    std::vector<std::string_view> ReadStrings();
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t offset_ = 0;
+
+    const uint8_t* ReadBytes(size_t size);
+    void Align();
+};
+
+template <typename T>
+void SnapshotWriter::Write(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    WriteBytes(&value, sizeof(T));
+}
+
+template <typename T>
+void SnapshotWriter::WriteArray(std::span<const T> values) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    Write(static_cast<uint64_t>(values.size()));
+    Align();
+    WriteBytes(values.data(), values.size_bytes());
+}
+
+template <typename T>
+T SnapshotReader::Read() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value;
+    std::memcpy(&value, ReadBytes(sizeof(T)), sizeof(T));
+    return value;
+}
+
+template <typename T>
+std::span<const T> SnapshotReader::ReadArray() {
+    static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= 8);
+    const uint64_t count = Read<uint64_t>();
+    Align();
+    if (count > (size_ - offset_) / sizeof(T)) {
+        throw std::runtime_error(std::string("Truncated snapshot"));
+    }
+    return { reinterpret_cast<const T*>(ReadBytes(count * sizeof(T))), static_cast<size_t>(count) };
+}
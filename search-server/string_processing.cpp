@@ -1,23 +1,92 @@
 #include "string_processing.h"
 #include <algorithm>
+#include <bit>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STRING_PROCESSING_SSE2
+#endif
+
+namespace {
+constexpr size_t SCAN_BLOCK_SIZE = 16;
+
+// Bit i of spaces and controls tells whether data[i] is a space or a control character (code below ' ')
+void ScanBlock(const char* data, size_t size, uint32_t& spaces, uint32_t& controls) {
+#ifdef STRING_PROCESSING_SSE2
+    if (size == SCAN_BLOCK_SIZE) {
+        const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        spaces = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' '))));
+        // unsigned chars <= ' ' - 1
+        controls = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(chars, _mm_set1_epi8(' ' - 1)), chars)));
+        return;
+    }
+#endif
+    spaces = 0;
+    controls = 0;
+    for (size_t i = 0; i < size; ++i) {
+        const auto c = static_cast<unsigned char>(data[i]);
+        spaces |= static_cast<uint32_t>(c == ' ') << i;
+        controls |= static_cast<uint32_t>(c < ' ') << i;
+    }
+}
+}
+
 std::vector<std::string_view> SplitIntoWords(const std::string_view text) {
     std::vector<std::string_view> words;
-    int position = 0;
-    int length = 0;
-    std::for_each(text.begin(), text.end(), [&](const char c) {
-        if (c == ' ') {
-            if (length!=0) {
-                words.push_back(text.substr(position, length));
-                position += length;
-                length = 0;
+    SplitIntoWords(text, words);
+    return words;
+}
+
+template <typename Allocator>
+size_t SplitIntoWords(const std::string_view text, std::vector<std::string_view, Allocator>& words) {
+    words.clear();
+    size_t first_invalid = SIZE_MAX;
+    size_t word_begin = 0;
+    bool in_word = false;
+    bool has_controls = false;
+    const auto add_word = [&](size_t word_end) {
+        if (has_controls && first_invalid == SIZE_MAX) {
+            first_invalid = words.size();
+        }
+        words.push_back(text.substr(word_begin, word_end - word_begin));
+        in_word = false;
+    };
+    for (size_t block = 0; block < text.size(); block += SCAN_BLOCK_SIZE) {
+        const size_t size = std::min(SCAN_BLOCK_SIZE, text.size() - block);
+        uint32_t spaces = 0;
+        uint32_t controls = 0;
+        ScanBlock(text.data() + block, size, spaces, controls);
+        const uint32_t block_mask = (1u << size) - 1;
+        size_t pos = 0;
+        while (pos < size) {
+            const uint32_t rest = block_mask & (~0u << pos);
+            if (in_word) {
+                const uint32_t word_ends = spaces & rest;
+                const size_t end = word_ends == 0 ? size : static_cast<size_t>(std::countr_zero(word_ends));
+                has_controls = has_controls || (controls & rest & ((1u << end) - 1)) != 0;
+                if (word_ends == 0) {
+                    break;
+                }
+                add_word(block + end);
+                pos = end + 1;
+            } else {
+                const uint32_t word_begins = ~spaces & rest;
+                if (word_begins == 0) {
+                    break;
+                }
+                pos = static_cast<size_t>(std::countr_zero(word_begins));
+                word_begin = block + pos;
+                in_word = true;
+                has_controls = false;
             }
-            ++position;
-        } else {
-            ++length;
         }
-    }); 
-    if (length != 0) {
-        words.push_back(text.substr(position, length));
     }
-    return words;
+    if (in_word) {
+        add_word(text.size());
+    }
+    return first_invalid == SIZE_MAX ? words.size() : first_invalid;
 }
+
+template size_t SplitIntoWords(const std::string_view text, std::vector<std::string_view>& words);
+template size_t SplitIntoWords(const std::string_view text, std::pmr::vector<std::string_view>& words);
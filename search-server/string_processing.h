@@ -1,9 +1,17 @@
 #pragma once
+#include <cstddef>
+#include <memory_resource>
 #include <string>
 #include <set>
 #include <vector>
 
 std::vector<std::string_view> SplitIntoWords(const std::string_view text);
+// Splits text on spaces into words (the buffer is cleared first, its capacity reused). Spaces and control
+// characters are found in the same pass, 16 bytes at a time with SSE2 where available.
+// Returns the index of the first word containing a control character, words.size() if there is none.
+// Instantiated for std::vector and std::pmr::vector.
+template <typename Allocator>
+size_t SplitIntoWords(const std::string_view text, std::vector<std::string_view, Allocator>& words);
 
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
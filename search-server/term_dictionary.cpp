@@ -0,0 +1,51 @@
+#include "term_dictionary.h"
+#include <algorithm>
+#include <cstring>
+
+TermId TermDictionary::Intern(std::string_view term) {
+    const auto it = ids_.find(term);
+    if (it != ids_.end()) {
+        return it->second;
+    }
+    const TermId id = static_cast<TermId>(terms_.size());
+    const std::string_view stored = Store(term);
+    terms_.push_back(stored);
+    ids_.emplace(stored, id);
+    return id;
+}
+
+TermId TermDictionary::InternExternal(std::string_view term) {
+    const auto [it, inserted] = ids_.emplace(term, static_cast<TermId>(terms_.size()));
+    if (inserted) {
+        terms_.push_back(term);
+    }
+    return it->second;
+}
+
+TermId TermDictionary::Find(std::string_view term) const {
+    const auto it = ids_.find(term);
+    return it == ids_.end() ? NO_TERM : it->second;
+}
+
+std::string_view TermDictionary::GetTerm(TermId id) const {
+    return terms_.at(id);
+}
+
+size_t TermDictionary::Size() const {
+    return terms_.size();
+}
+
+std::string_view TermDictionary::Store(std::string_view term) {
+    if (term.size() > chunk_free_) {
+        // a word that doesn't fit starts a new chunk, sized up for oversized words
+        const size_t size = std::max(term.size(), CHUNK_SIZE);
+        chunks_.push_back(std::make_unique<char[]>(size));
+        chunk_pos_ = chunks_.back().get();
+        chunk_free_ = size;
+    }
+    std::memcpy(chunk_pos_, term.data(), term.size());
+    const std::string_view stored(chunk_pos_, term.size());
+    chunk_pos_ += term.size();
+    chunk_free_ -= term.size();
+    return stored;
+}
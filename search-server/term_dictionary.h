@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using TermId = uint32_t;
+
+// Assigns dense ids to words. The bytes of every word are copied once into an append-only arena,
+// so the string_views handed out stay valid for the dictionary's lifetime.
+class TermDictionary {
+public:
+    static constexpr TermId NO_TERM = UINT32_MAX;
+
+    TermDictionary() = default;
+    TermDictionary(const TermDictionary&) = delete;
+    TermDictionary& operator=(const TermDictionary&) = delete;
+    TermDictionary(TermDictionary&&) = default;
+    TermDictionary& operator=(TermDictionary&&) = default;
+
+    // Returns the id of term, registering it first if needed
+    TermId Intern(std::string_view term);
+    // Like Intern, but keeps referring to the caller's bytes, which must outlive the dictionary
+    TermId InternExternal(std::string_view term);
+    // Returns NO_TERM for unknown words
+    TermId Find(std::string_view term) const;
+    std::string_view GetTerm(TermId id) const;
+    size_t Size() const;
+
+private:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    size_t chunk_free_ = 0;
+    char* chunk_pos_ = nullptr;
+    std::vector<std::string_view> terms_;
+    std::unordered_map<std::string_view, TermId> ids_;
+
+    std::string_view Store(std::string_view term);
+};
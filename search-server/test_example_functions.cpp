@@ -0,0 +1,1423 @@
+#include "test_example_functions.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "concurrent_search_server.h"
+#include "docid_bitmap.h"
+#include "document_columns.h"
+#include "lru_cache.h"
+#include "perfect_hash_set.h"
+#include "posting_list.h"
+#include "request_queue.h"
+#include "search_server.h"
+#include "segmented_search_server.h"
+#include "sharded_search_server.h"
+#include "string_processing.h"
+#include "top_documents.h"
+
+namespace {
+void Check(bool condition, const std::string& message) {
+    if (!condition) {
+        throw std::logic_error(message);
+    }
+}
+
+std::string ToString(const std::vector<Document>& documents) {
+    std::ostringstream out;
+    for (const Document& document : documents) {
+        out << document << ' ';
+    }
+    return out.str();
+}
+
+// Same ids and ratings in the same order, relevances equal up to rounding
+void CheckSameDocuments(const std::vector<Document>& actual, const std::vector<Document>& expected, const std::string& name) {
+    bool is_same = actual.size() == expected.size();
+    for (size_t i = 0; i < actual.size() && is_same; ++i) {
+        is_same = actual[i].id == expected[i].id && actual[i].rating == expected[i].rating
+            && std::abs(actual[i].relevance - expected[i].relevance) <= 1e-9 * std::max(1.0, std::abs(expected[i].relevance));
+    }
+    Check(is_same, name + std::string(": got ") + ToString(actual) + std::string("expected ") + ToString(expected));
+}
+
+// The baseline ranking: results came in docid order and were sorted by this comparator
+bool IsBetterBaseline(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < std::numeric_limits<double>::epsilon()) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+// A corpus mirrored outside the server, without its stop words
+struct TestDocument {
+    std::vector<std::string> words;
+    DocumentStatus status;
+    int rating;
+};
+using TestCorpus = std::map<int, TestDocument>;
+
+const std::string TEST_STOP_WORDS("and with in");
+
+std::string TestWord(size_t index) {
+    return std::string("w") + std::to_string(index);
+}
+
+// Zipf-distributed words, so a few are frequent and many documents tie; stop words are mixed in.
+// Every document gets the most frequent word with the given probability.
+std::pair<TestDocument, std::string> MakeTestDocument(std::mt19937& generator, size_t vocabulary_size, double first_word_share = 0.0) {
+    std::vector<double> weights(vocabulary_size);
+    for (size_t i = 0; i < vocabulary_size; ++i) {
+        weights[i] = 1.0 / (i + 1);
+    }
+    std::discrete_distribution<size_t> word_distribution(weights.begin(), weights.end());
+    TestDocument document{ {}, static_cast<DocumentStatus>(generator() % 4), static_cast<int>(generator() % 5) - 1 };
+    std::string text;
+    if (std::bernoulli_distribution(first_word_share)(generator)) {
+        document.words.push_back(TestWord(0));
+        text += TestWord(0);
+    }
+    const size_t length = 1 + generator() % 12;
+    for (size_t i = 0; i < length; ++i) {
+        if (generator() % 5 == 0) {
+            text += std::string(" with");
+        }
+        document.words.push_back(TestWord(word_distribution(generator)));
+        text += std::string(" ") + document.words.back();
+    }
+    return { document, text };
+}
+
+void AddTestDocument(SearchServer& search_server, TestCorpus& corpus, int document_id, std::mt19937& generator,
+    size_t vocabulary_size, double first_word_share = 0.0) {
+    auto [document, text] = MakeTestDocument(generator, vocabulary_size, first_word_share);
+    search_server.AddDocument(document_id, text, document.status, { document.rating });
+    corpus[document_id] = std::move(document);
+}
+
+void RemoveTestDocument(SearchServer& search_server, TestCorpus& corpus, int document_id) {
+    search_server.RemoveDocument(document_id);
+    corpus.erase(document_id);
+}
+
+struct TestQuery {
+    std::vector<std::string> plus_words;
+    std::vector<std::string> minus_words;
+    std::string text;
+};
+
+// One to four plus words and up to two minus words; some words are missing from the index
+TestQuery MakeTestQuery(std::mt19937& generator, size_t vocabulary_size) {
+    TestQuery query;
+    const size_t plus_count = 1 + generator() % 4;
+    const size_t minus_count = generator() % 3;
+    for (size_t i = 0; i < plus_count + minus_count; ++i) {
+        // the most frequent words come up often, so are excluded through bitmaps
+        const size_t index = generator() % 3 == 0 ? generator() % 3 : generator() % (vocabulary_size + 2);
+        auto& words = i < plus_count ? query.plus_words : query.minus_words;
+        words.push_back(TestWord(index));
+        query.text += (i < plus_count ? std::string(" ") : std::string(" -")) + words.back();
+    }
+    return query;
+}
+
+// Scores every matched document, in word order as the baseline did, then ranks them as TopDocuments does
+template <typename Scoring, typename DocumentPredicate>
+std::vector<Document> FindTopDocumentsExhaustive(const TestCorpus& corpus, const Scoring& scoring, const TestQuery& query,
+    DocumentPredicate document_predicate, size_t top_count) {
+    std::vector<std::string> plus_words = query.plus_words;
+    std::sort(plus_words.begin(), plus_words.end());
+    plus_words.erase(std::unique(plus_words.begin(), plus_words.end()), plus_words.end());
+    const int document_count = static_cast<int>(corpus.size());
+    int64_t total_word_count = 0;
+    std::map<std::string, int> document_freqs;
+    for (const auto& [document_id, document] : corpus) {
+        total_word_count += document.words.size();
+        for (const std::string& word : plus_words) {
+            document_freqs[word] += std::count(document.words.begin(), document.words.end(), word) > 0 ? 1 : 0;
+        }
+    }
+    const double average_word_count = document_count == 0 ? 0.0 : total_word_count * 1.0 / document_count;
+    std::vector<Document> matched_documents;
+    for (const auto& [document_id, document] : corpus) {
+        const bool has_minus_word = std::any_of(query.minus_words.begin(), query.minus_words.end(), [&document](const std::string& word) {
+            return std::count(document.words.begin(), document.words.end(), word) > 0;
+        });
+        if (has_minus_word) {
+            continue;
+        }
+        const int word_count = static_cast<int>(document.words.size());
+        const double inv_word_count = 1.0 / word_count;
+        const double length_norm = scoring.LengthNorm(word_count, average_word_count);
+        double relevance = 0.0;
+        bool is_matched = false;
+        for (const std::string& word : plus_words) {
+            double term_freq = 0.0;
+            for (const std::string& document_word : document.words) {
+                term_freq += document_word == word ? inv_word_count : 0.0;
+            }
+            if (term_freq > 0.0) {
+                relevance += scoring.TermScore(term_freq, length_norm, scoring.InverseDocumentFreq(document_count, document_freqs[word]));
+                is_matched = true;
+            }
+        }
+        if (is_matched && document_predicate(document_id, document.status, document.rating)) {
+            matched_documents.push_back({ document_id, relevance, document.rating });
+        }
+    }
+    std::stable_sort(matched_documents.begin(), matched_documents.end(), TopDocuments::IsBetter);
+    matched_documents.resize(std::min(matched_documents.size(), top_count));
+    return matched_documents;
+}
+
+// Random queries with status and predicate filters, sequential and parallel, against exhaustive scoring
+template <typename Scoring>
+void CheckRandomQueries(const SearchServer& search_server, const TestCorpus& corpus, const Scoring& scoring,
+    std::mt19937& generator, size_t vocabulary_size, const std::string& name) {
+    const auto predicate = [](int document_id, DocumentStatus status, int rating) {
+        return document_id % 3 != 0 && status != DocumentStatus::REMOVED && rating >= 0;
+    };
+    for (int query_index = 0; query_index < 40; ++query_index) {
+        const TestQuery query = MakeTestQuery(generator, vocabulary_size);
+        const size_t top_count = std::vector<size_t>{ 1, 3, 5, 20 }[generator() % 4];
+        const DocumentStatus status = static_cast<DocumentStatus>(generator() % 4);
+        const std::string query_name = name + std::string(", query") + query.text + std::string(", top ") + std::to_string(top_count);
+        const auto expected_status = FindTopDocumentsExhaustive(corpus, scoring, query, [status](int, DocumentStatus document_status, int) {
+            return document_status == status;
+        }, top_count);
+        const auto expected_predicate = FindTopDocumentsExhaustive(corpus, scoring, query, predicate, top_count);
+        if constexpr (std::is_same_v<Scoring, TfIdfScoring>) {
+            CheckSameDocuments(search_server.FindTopDocuments(std::execution::seq, query.text, status, top_count), expected_status, query_name);
+            CheckSameDocuments(search_server.FindTopDocuments(std::execution::par, query.text, status, top_count), expected_status, query_name);
+            CheckSameDocuments(search_server.FindTopDocuments(std::execution::seq, query.text, predicate, top_count), expected_predicate, query_name);
+            CheckSameDocuments(search_server.FindTopDocuments(std::execution::par, query.text, predicate, top_count), expected_predicate, query_name);
+        } else {
+            CheckSameDocuments(search_server.FindTopDocuments(std::execution::seq, scoring, query.text, status, top_count), expected_status, query_name);
+            CheckSameDocuments(search_server.FindTopDocuments(std::execution::par, scoring, query.text, status, top_count), expected_status, query_name);
+            CheckSameDocuments(search_server.FindTopDocuments(std::execution::seq, scoring, query.text, predicate, top_count), expected_predicate, query_name);
+            CheckSameDocuments(search_server.FindTopDocuments(std::execution::par, scoring, query.text, predicate, top_count), expected_predicate, query_name);
+        }
+    }
+}
+
+// A phrase is a run of the words in order; with a slop, a window of phrase.size() + slop words holding every
+// phrase word as many times as the phrase does
+bool HasPhraseExhaustive(const std::vector<std::string>& words, const std::vector<std::string>& phrase, int slop) {
+    if (slop < 0) {
+        return std::search(words.begin(), words.end(), phrase.begin(), phrase.end()) != words.end();
+    }
+    const size_t window = phrase.size() + slop;
+    for (size_t begin = 0; begin < words.size(); ++begin) {
+        const auto end = words.begin() + std::min(words.size(), begin + window);
+        const bool is_matched = std::all_of(phrase.begin(), phrase.end(), [&](const std::string& word) {
+            return std::count(words.begin() + begin, end, word) >= std::count(phrase.begin(), phrase.end(), word);
+        });
+        if (is_matched) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The scalar splitter the block scan replaced: words between single spaces, and the first of them holding
+// a control character
+std::pair<std::vector<std::string_view>, size_t> SplitIntoWordsScalar(const std::string_view text) {
+    std::vector<std::string_view> words;
+    size_t first_invalid = SIZE_MAX;
+    size_t word_begin = 0;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        if (i < text.size() && text[i] != ' ') {
+            continue;
+        }
+        if (i > word_begin) {
+            words.push_back(text.substr(word_begin, i - word_begin));
+            const bool has_controls = std::any_of(words.back().begin(), words.back().end(), [](char c) {
+                return static_cast<unsigned char>(c) < ' ';
+            });
+            if (has_controls && first_invalid == SIZE_MAX) {
+                first_invalid = words.size() - 1;
+            }
+        }
+        word_begin = i + 1;
+    }
+    return { words, first_invalid == SIZE_MAX ? words.size() : first_invalid };
+}
+
+// Docids are multiples of 4 at first, so later additions fall between them and go to the posting deltas.
+// Removals leave zeroed or tombstoned postings; the states are checked before and after compaction.
+template <typename Scoring>
+void CheckPruningAgainstExhaustive(const Scoring& scoring, const std::string& name) {
+    constexpr size_t VOCABULARY_SIZE = 40;
+    std::mt19937 generator(42);
+    SearchServer search_server(TEST_STOP_WORDS);
+    TestCorpus corpus;
+    // the first word is in most documents, so its list keeps a docid bitmap
+    for (int i = 0; i < 6000; ++i) {
+        AddTestDocument(search_server, corpus, 4 * i, generator, VOCABULARY_SIZE, 0.8);
+    }
+    CheckRandomQueries(search_server, corpus, scoring, generator, VOCABULARY_SIZE, name + std::string(", appended"));
+    const auto update = [&](int remove_count, int add_count) {
+        for (int i = 0; i < remove_count; ++i) {
+            const auto it = corpus.lower_bound(static_cast<int>(generator() % 24000));
+            if (it != corpus.end()) {
+                RemoveTestDocument(search_server, corpus, it->first);
+            }
+        }
+        for (int i = 0; i < add_count; ++i) {
+            const int document_id = static_cast<int>(generator() % 24000);
+            if (corpus.count(document_id) == 0) {
+                AddTestDocument(search_server, corpus, document_id, generator, VOCABULARY_SIZE, 0.8);
+            }
+        }
+    };
+    update(600, 300);
+    CheckRandomQueries(search_server, corpus, scoring, generator, VOCABULARY_SIZE, name + std::string(", plain with deltas"));
+    search_server.Compact(PostingFormat::COMPRESSED);
+    CheckRandomQueries(search_server, corpus, scoring, generator, VOCABULARY_SIZE, name + std::string(", compressed"));
+    update(300, 200);
+    CheckRandomQueries(search_server, corpus, scoring, generator, VOCABULARY_SIZE, name + std::string(", compressed with deltas"));
+    search_server.Compact(PostingFormat::PLAIN);
+    CheckRandomQueries(search_server, corpus, scoring, generator, VOCABULARY_SIZE, name + std::string(", compacted"));
+}
+
+// The term frequency AddDocument computes for count occurrences among length words
+double SumTermFreq(uint32_t count, uint32_t length) {
+    const double inv_word_count = 1.0 / length;
+    double term_freq = 0.0;
+    for (uint32_t i = 0; i < count; ++i) {
+        term_freq += inv_word_count;
+    }
+    return term_freq;
+}
+
+// Both lists hold the same live postings with bit-identical frequencies, also when reached by SkipTo
+void CheckSamePostings(const PostingList& actual, const PostingList& expected, std::mt19937& generator, const std::string& name) {
+    std::vector<std::pair<int, double>> actual_postings;
+    std::vector<std::pair<int, double>> expected_postings;
+    actual.ForEach([&actual_postings](int document_id, double term_freq) {
+        actual_postings.emplace_back(document_id, term_freq);
+    });
+    expected.ForEach([&expected_postings](int document_id, double term_freq) {
+        expected_postings.emplace_back(document_id, term_freq);
+    });
+    Check(actual_postings == expected_postings, name + std::string(": postings differ"));
+    Check(actual.Size() == expected.Size(), name + std::string(": sizes differ"));
+    PostingList::Cursor actual_cursor(actual);
+    PostingList::Cursor expected_cursor(expected);
+    for (int target = 0; !expected_cursor.IsEnd(); target += 1 + static_cast<int>(generator() % 300)) {
+        actual_cursor.SkipTo(target);
+        expected_cursor.SkipTo(target);
+        Check(actual_cursor.IsEnd() == expected_cursor.IsEnd(), name + std::string(": SkipTo ends differently"));
+        if (!expected_cursor.IsEnd()) {
+            Check(actual_cursor.DocumentId() == expected_cursor.DocumentId() && actual_cursor.TermFreq() == expected_cursor.TermFreq(),
+                name + std::string(": SkipTo(") + std::to_string(target) + std::string(") differs"));
+            const int document_id = expected_cursor.DocumentId();
+            Check(actual.Contains(document_id) && actual.Contains(document_id - 1) == expected.Contains(document_id - 1),
+                name + std::string(": Contains differs"));
+        }
+    }
+    Check(actual_cursor.IsEnd(), name + std::string(": extra postings after SkipTo"));
+}
+}
+
+#ifdef SEARCH_SERVER_COUNT_ALLOCATIONS
+namespace {
+constexpr int WARM_UP_RUNS = 3;
+constexpr int MEASURED_RUNS = 20;
+
+SearchServer MakeTestServer(PostingFormat format) {
+    SearchServer search_server(std::string("and with in"));
+    const std::vector<std::string> words = { "white", "black", "curly", "nasty", "cat", "dog", "tail", "eyes",
+        "pigeon", "hat", "collar", "fluffy", "big", "small" };
+    for (int id = 0; id < 2000; ++id) {
+        std::string text;
+        for (int word = 0; word < 6; ++word) {
+            text += words[(id * 7 + word * word * 3 + id / 13) % words.size()] + " ";
+        }
+        search_server.AddDocument(id, text, static_cast<DocumentStatus>(id % 4), { id % 5, id % 3 });
+    }
+    search_server.Compact(format);
+    return search_server;
+}
+
+void CheckAllocations(const std::string& name, uint64_t max_allocations, const std::function<void()>& query) {
+    for (int run = 0; run < WARM_UP_RUNS; ++run) {
+        query();
+    }
+    for (int run = 0; run < MEASURED_RUNS; ++run) {
+        const uint64_t before = GetThreadAllocationCount();
+        query();
+        const uint64_t allocations = GetThreadAllocationCount() - before;
+        if (allocations > max_allocations) {
+            throw std::logic_error(name + std::string(" made ") + std::to_string(allocations)
+                + std::string(" allocations, expected at most ") + std::to_string(max_allocations));
+        }
+    }
+}
+}
+#endif
+
+void TestTopDocumentsOrder() {
+    // groups of epsilon-equal relevances with equal ratings inside, pushed in a shuffled order
+    const double base = 0.5;
+    const double next = std::nextafter(base, 1.0);
+    std::vector<Document> documents;
+    for (int id = 0; id < 40; ++id) {
+        const double relevance = id % 4 == 0 ? 0.75 : id % 2 == 0 ? base : next;
+        documents.push_back({ id, relevance, id % 3 == 0 ? 1 : 2 });
+    }
+    std::vector<Document> expected = documents;
+    std::stable_sort(expected.begin(), expected.end(), IsBetterBaseline);
+    std::mt19937 generator(7);
+    for (const size_t capacity : { size_t{ 1 }, size_t{ 5 }, size_t{ 17 }, size_t{ 40 }, size_t{ 64 } }) {
+        std::shuffle(documents.begin(), documents.end(), generator);
+        TopDocuments top_documents(capacity);
+        for (const Document& document : documents) {
+            top_documents.Push(document);
+        }
+        const std::vector<Document> top(expected.begin(), expected.begin() + std::min(capacity, expected.size()));
+        CheckSameDocuments(top_documents.Extract(), top, std::string("top ") + std::to_string(capacity));
+    }
+
+    // the demo of main.cpp: documents 1 and 3 tie on relevance and rating and keep their id order
+    SearchServer search_server(std::string("and with"));
+    int id = 0;
+    for (const std::string text : { "white cat and yellow hat", "curly cat curly tail", "nasty dog with big eyes", "nasty pigeon john" }) {
+        search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, { 1, 2 });
+    }
+    const auto found = search_server.FindTopDocuments(std::string("curly nasty cat"));
+    std::vector<int> ids;
+    for (const Document& document : found) {
+        ids.push_back(document.id);
+    }
+    Check(ids == std::vector<int>{ 2, 4, 1, 3 }, std::string("demo order: ") + ToString(found));
+}
+
+void TestFindTopDocumentsPruning() {
+    CheckPruningAgainstExhaustive(TfIdfScoring{}, std::string("TF-IDF"));
+    CheckPruningAgainstExhaustive(Bm25Scoring{}, std::string("BM25"));
+    CheckPruningAgainstExhaustive(Bm25Scoring{ 2.0, 0.3 }, std::string("BM25, k1 2.0, b 0.3"));
+}
+
+void TestPostingListCompression() {
+    std::mt19937 generator(5);
+    // word counts go past three, where summing 1 / length no longer rounds like one multiplication
+    std::map<int, uint32_t> lengths;
+    PostingList plain;
+    PostingList compressed;
+    for (int document_id = 0; document_id < 20000; document_id += 1 + static_cast<int>(generator() % 7)) {
+        const uint32_t length = 1 + generator() % 2000;
+        const uint32_t count = 1 + generator() % std::min<uint32_t>(length, generator() % 4 == 0 ? 200 : 3);
+        lengths[document_id] = length;
+        plain.Add(document_id, SumTermFreq(count, length));
+        compressed.Add(document_id, SumTermFreq(count, length));
+    }
+    const auto word_count = [&lengths](int document_id) {
+        return lengths.at(document_id);
+    };
+    compressed.Compress(word_count);
+    Check(compressed.Format() == PostingFormat::COMPRESSED, std::string("list was not compressed"));
+    CheckSamePostings(compressed, plain, generator, std::string("compressed"));
+
+    // tombstones and a delta of out-of-order and re-added documents
+    for (int i = 0; i < 500; ++i) {
+        const int document_id = static_cast<int>(generator() % 20000);
+        Check(compressed.Remove(document_id) == plain.Remove(document_id), std::string("Remove differs"));
+    }
+    for (int i = 0; i < 500; ++i) {
+        const int document_id = static_cast<int>(generator() % 21000);
+        if (!plain.Contains(document_id)) {
+            const uint32_t length = 1 + generator() % 100;
+            const double term_freq = SumTermFreq(1 + generator() % length, length);
+            lengths[document_id] = length;
+            plain.Add(document_id, term_freq);
+            compressed.Add(document_id, term_freq);
+        }
+    }
+    CheckSamePostings(compressed, plain, generator, std::string("compressed with tombstones and delta"));
+    compressed.Compress(word_count);
+    Check(compressed.Format() == PostingFormat::COMPRESSED && compressed.IsCompact(), std::string("list was not recompressed"));
+    CheckSamePostings(compressed, plain, generator, std::string("recompressed"));
+    compressed.Compact();
+    CheckSamePostings(compressed, plain, generator, std::string("decompressed"));
+}
+
+void TestSnapshot() {
+    constexpr size_t VOCABULARY_SIZE = 30;
+    std::mt19937 generator(11);
+    SearchServer search_server(TEST_STOP_WORDS);
+    search_server.SetPositionIndexing(true);
+    TestCorpus corpus;
+    for (int i = 0; i < 1500; ++i) {
+        AddTestDocument(search_server, corpus, 2 * i, generator, VOCABULARY_SIZE);
+    }
+    // compressed lists with tombstones and deltas, next to plain ones
+    search_server.Compact(PostingFormat::COMPRESSED);
+    for (int i = 0; i < 100; ++i) {
+        RemoveTestDocument(search_server, corpus, 30 * i);
+        AddTestDocument(search_server, corpus, 1 + 30 * i, generator, VOCABULARY_SIZE);
+    }
+    const std::string path = (std::filesystem::temp_directory_path() / "search_server_test.snapshot").string();
+    search_server.SaveSnapshot(path);
+    {
+        const SearchServer loaded = SearchServer::LoadSnapshot(path);
+        Check(loaded.GetDocumentCount() == search_server.GetDocumentCount(), std::string("loaded document count differs"));
+        CheckRandomQueries(loaded, corpus, TfIdfScoring{}, generator, VOCABULARY_SIZE, std::string("loaded snapshot"));
+        for (const std::string query : { "\"w1 w2\"", "\"w0 w3\"~2 -w5", "w4 \"w1 w1\"~1" }) {
+            CheckSameDocuments(loaded.FindTopDocuments(query), search_server.FindTopDocuments(query), std::string("loaded snapshot, query ") + query);
+        }
+        for (const auto& [document_id, document] : corpus) {
+            Check(loaded.MatchDocument(std::string("w1 w2 w3 -w9"), document_id) == search_server.MatchDocument(std::string("w1 w2 w3 -w9"), document_id),
+                std::string("loaded snapshot matches document ") + std::to_string(document_id) + std::string(" differently"));
+        }
+    }
+
+    std::vector<char> bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    const auto write = [&path](const std::vector<char>& content, size_t size) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(content.data(), static_cast<std::streamsize>(size));
+    };
+    // any truncation is detected
+    for (size_t size = 1; size < bytes.size(); size += 1 + bytes.size() / 300) {
+        write(bytes, size);
+        bool is_rejected = false;
+        try {
+            SearchServer::LoadSnapshot(path);
+        } catch (const std::runtime_error&) {
+            is_rejected = true;
+        }
+        Check(is_rejected, std::string("snapshot truncated to ") + std::to_string(size) + std::string(" bytes was loaded"));
+    }
+    // a corrupted byte either is rejected or leaves an index that can be searched
+    for (int trial = 0; trial < 2000; ++trial) {
+        std::vector<char> corrupted = bytes;
+        corrupted[generator() % corrupted.size()] ^= static_cast<char>(1 + generator() % 255);
+        write(corrupted, corrupted.size());
+        try {
+            const SearchServer loaded = SearchServer::LoadSnapshot(path);
+            for (const std::string query : { "w0 w1 -w2", "w3 w4 w5 w6", "\"w1 w2\"~1" }) {
+                loaded.FindTopDocuments(query);
+                loaded.FindTopDocuments(std::execution::par, query, [](int, DocumentStatus, int) {
+                    return true;
+                });
+            }
+        } catch (const std::runtime_error&) {
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+void TestInvalidDocumentStatus() {
+    const DocumentStatus invalid_status = static_cast<DocumentStatus>(DocumentColumns::STATUS_COUNT);
+    const auto check_unchanged = [](const SearchServer& search_server, const std::string& name) {
+        Check(search_server.GetDocumentCount() == 1, name + std::string(": document count changed"));
+        CheckSameDocuments(search_server.FindTopDocuments(std::string("cat dog"), [](int, DocumentStatus, int) {
+            return true;
+        }), { { 1, 0.0, 5 } }, name);
+        Check(search_server.GetWordFrequencies(2).empty(), name + std::string(": rejected document has words"));
+    };
+    const auto check_rejected = [&check_unchanged](SearchServer& search_server, const std::function<void()>& add, const std::string& name) {
+        bool is_rejected = false;
+        try {
+            add();
+        } catch (const std::invalid_argument&) {
+            is_rejected = true;
+        }
+        Check(is_rejected, name + std::string(": invalid status accepted"));
+        check_unchanged(search_server, name);
+        search_server.AddDocument(2, "dog", DocumentStatus::ACTUAL, { 1 });
+        search_server.RemoveDocument(2);
+        check_unchanged(search_server, name + std::string(", id reused"));
+    };
+
+    SearchServer search_server(TEST_STOP_WORDS);
+    search_server.AddDocument(1, "cat", DocumentStatus::ACTUAL, { 5 });
+    check_rejected(search_server, [&search_server, invalid_status] {
+        search_server.AddDocument(2, "dog cat", invalid_status, { 1 });
+    }, std::string("AddDocument"));
+    const std::vector<SearchServer::NewDocument> batch = {
+        { 3, "dog", DocumentStatus::ACTUAL, { 1 } },
+        { 2, "dog cat", invalid_status, { 1 } },
+        { 4, "cat", DocumentStatus::BANNED, { 1 } },
+    };
+    check_rejected(search_server, [&search_server, &batch] {
+        search_server.AddDocuments(batch);
+    }, std::string("AddDocuments"));
+    check_rejected(search_server, [&search_server, &batch] {
+        search_server.AddDocuments(std::execution::par, batch);
+    }, std::string("parallel AddDocuments"));
+}
+
+void TestSegmentedSearchServer() {
+    constexpr size_t VOCABULARY_SIZE = 40;
+    std::mt19937 generator(17);
+    SegmentedSearchServer segmented_server(TEST_STOP_WORDS, 50, 2);
+    SearchServer search_server(TEST_STOP_WORDS);
+    TestCorpus corpus;
+    const auto check_same_results = [&](const std::string& name) {
+        Check(segmented_server.GetDocumentCount() == search_server.GetDocumentCount(), name + std::string(": document counts differ"));
+        const auto predicate = [](int document_id, DocumentStatus status, int rating) {
+            return document_id % 3 != 0 && status != DocumentStatus::REMOVED && rating >= 0;
+        };
+        for (int query_index = 0; query_index < 40; ++query_index) {
+            const TestQuery query = MakeTestQuery(generator, VOCABULARY_SIZE);
+            const size_t top_count = std::vector<size_t>{ 1, 3, 5, 20 }[generator() % 4];
+            const DocumentStatus status = static_cast<DocumentStatus>(generator() % 4);
+            const std::string query_name = name + std::string(", query") + query.text + std::string(", top ") + std::to_string(top_count);
+            CheckSameDocuments(segmented_server.FindTopDocuments(query.text, status, top_count),
+                search_server.FindTopDocuments(query.text, status, top_count), query_name);
+            CheckSameDocuments(segmented_server.FindTopDocuments(query.text, predicate, top_count),
+                search_server.FindTopDocuments(query.text, predicate, top_count), query_name);
+        }
+        for (int i = 0; i < 20 && !corpus.empty(); ++i) {
+            const int document_id = std::next(corpus.begin(), generator() % corpus.size())->first;
+            Check(segmented_server.MatchDocument("w0 w1 w2 -w3", document_id) == search_server.MatchDocument("w0 w1 w2 -w3", document_id),
+                name + std::string(": document ") + std::to_string(document_id) + std::string(" matched differently"));
+        }
+    };
+
+    int next_id = 0;
+    for (int round = 0; round < 30; ++round) {
+        // each batch flushes segments and starts merges, the removals right after it race with them
+        for (int i = 0; i < 120; ++i) {
+            auto [document, text] = MakeTestDocument(generator, VOCABULARY_SIZE);
+            segmented_server.AddDocument(next_id, text, document.status, { document.rating });
+            search_server.AddDocument(next_id, text, document.status, { document.rating });
+            corpus[next_id++] = std::move(document);
+        }
+        for (int i = 0; i < 60; ++i) {
+            const int document_id = static_cast<int>(generator() % next_id);
+            segmented_server.RemoveDocument(document_id);
+            RemoveTestDocument(search_server, corpus, document_id);
+        }
+        // some removed ids come back in the write segment while their tombstoned copies are still merged
+        for (int i = 0; i < 10; ++i) {
+            const int document_id = static_cast<int>(generator() % next_id);
+            if (corpus.count(document_id) == 0) {
+                auto [document, text] = MakeTestDocument(generator, VOCABULARY_SIZE);
+                segmented_server.AddDocument(document_id, text, document.status, { document.rating });
+                search_server.AddDocument(document_id, text, document.status, { document.rating });
+                corpus[document_id] = std::move(document);
+            }
+        }
+        if (round % 10 == 0) {
+            check_same_results(std::string("round ") + std::to_string(round));
+        }
+    }
+    segmented_server.WaitForMerges();
+    check_same_results(std::string("after merges"));
+    Check(segmented_server.GetSegmentCount() < static_cast<size_t>(next_id) / 50, std::string("segments were not merged"));
+    segmented_server.Flush();
+    segmented_server.WaitForMerges();
+    check_same_results(std::string("after flush and merges"));
+}
+
+void TestConcurrentSearchServerFailedUpdates() {
+    constexpr size_t VOCABULARY_SIZE = 20;
+    std::mt19937 generator(19);
+    ConcurrentSearchServer concurrent_server(TEST_STOP_WORDS);
+    SearchServer search_server(TEST_STOP_WORDS);
+    for (int document_id = 0; document_id < 300; ++document_id) {
+        auto [document, text] = MakeTestDocument(generator, VOCABULARY_SIZE);
+        concurrent_server.AddDocument(document_id, text, document.status, { document.rating });
+        search_server.AddDocument(document_id, text, document.status, { document.rating });
+    }
+    std::vector<std::string> queries;
+    for (int i = 0; i < 30; ++i) {
+        queries.push_back(MakeTestQuery(generator, VOCABULARY_SIZE).text);
+    }
+    // every update publishes the other copy, so an update that changes nothing shows the copy that was hidden
+    const auto check_copies = [&](const std::string& name) {
+        for (int copy = 0; copy < 2; ++copy) {
+            const std::string copy_name = name + std::string(", copy ") + std::to_string(copy);
+            Check(concurrent_server.GetDocumentCount() == search_server.GetDocumentCount(), copy_name + std::string(": document counts differ"));
+            for (const std::string& query : queries) {
+                for (int status = 0; status < 4; ++status) {
+                    CheckSameDocuments(concurrent_server.FindTopDocuments(query, static_cast<DocumentStatus>(status)),
+                        search_server.FindTopDocuments(query, static_cast<DocumentStatus>(status)), copy_name + std::string(", query") + query);
+                }
+            }
+            for (const int document_id : search_server) {
+                Check(concurrent_server.MatchDocument("w0 w1 w2 w3 w5", document_id) == search_server.MatchDocument("w0 w1 w2 w3 w5", document_id),
+                    copy_name + std::string(": document ") + std::to_string(document_id) + std::string(" matched differently"));
+            }
+            concurrent_server.RemoveDocument(-1);
+        }
+    };
+    const auto check_throws = [](const std::function<void()>& update, const std::string& name) {
+        bool is_thrown = false;
+        try {
+            update();
+        } catch (const std::exception&) {
+            is_thrown = true;
+        }
+        Check(is_thrown, name + std::string(": update did not throw"));
+    };
+    check_copies(std::string("initial"));
+
+    // throws on the first copy: nothing is published
+    check_throws([&concurrent_server] {
+        concurrent_server.AddDocument(5, "w1 w2", DocumentStatus::ACTUAL, { 1 });
+    }, std::string("duplicate id"));
+    check_copies(std::string("after a duplicate id"));
+    check_throws([&concurrent_server] {
+        concurrent_server.AddDocuments({ { 400, "w1 w3", DocumentStatus::ACTUAL, { 1 } }, { 7, "w2", DocumentStatus::ACTUAL, { 1 } } });
+    }, std::string("duplicate id in a batch"));
+    check_copies(std::string("after a duplicate id in a batch"));
+
+    // throws on the second copy after changing it: the update stays applied as it was on the first copy
+    concurrent_server.Compact(PostingFormat::COMPRESSED);
+    search_server.Compact(PostingFormat::COMPRESSED);
+    int call_count = 0;
+    check_throws([&concurrent_server, &call_count] {
+        concurrent_server.Update([&call_count](SearchServer& server) {
+            server.RemoveDocument(10);
+            server.AddDocument(500, "w4 w5 w5", DocumentStatus::ACTUAL, { 3 });
+            if (++call_count == 2) {
+                server.AddDocument(501, "w6", DocumentStatus::BANNED, { 2 });
+                server.RemoveDocument(11);
+                throw std::runtime_error("update failed");
+            }
+        });
+    }, std::string("failure on the second copy"));
+    search_server.RemoveDocument(10);
+    search_server.AddDocument(500, "w4 w5 w5", DocumentStatus::ACTUAL, { 3 });
+    check_copies(std::string("after a failure on the second copy"));
+
+    concurrent_server.AddDocument(600, "w4 w6", DocumentStatus::ACTUAL, { 4 });
+    search_server.AddDocument(600, "w4 w6", DocumentStatus::ACTUAL, { 4 });
+    check_copies(std::string("after a later update"));
+}
+
+void TestPhraseQueries() {
+    constexpr size_t VOCABULARY_SIZE = 6;
+    std::mt19937 generator(23);
+    SearchServer search_server(TEST_STOP_WORDS);
+    search_server.SetPositionIndexing(true);
+    TestCorpus corpus;
+    for (int document_id = 0; document_id < 2000; ++document_id) {
+        AddTestDocument(search_server, corpus, document_id, generator, VOCABULARY_SIZE);
+    }
+    // w7 is in no document
+    const std::vector<std::pair<std::vector<std::string>, int>> phrases = {
+        { { "w0", "w1" }, -1 }, { { "w1", "w0" }, -1 }, { { "w2", "w2" }, -1 }, { { "w0", "w1", "w2" }, -1 },
+        { { "w0", "w1" }, 0 }, { { "w0", "w1" }, 2 }, { { "w3", "w4" }, 5 },
+        { { "w0", "w0" }, 0 }, { { "w1", "w1" }, 1 }, { { "w2", "w2" }, 4 }, { { "w0", "w1", "w0" }, 3 },
+        { { "w5", "w3" }, -1 }, { { "w5", "w3" }, 1 }, { { "w0", "w7" }, -1 }, { { "w0", "w7" }, 3 },
+    };
+    const auto predicate = [](int, DocumentStatus, int) {
+        return true;
+    };
+    for (const auto& [phrase, slop] : phrases) {
+        for (const std::string& extra_words : { std::string(), std::string(" w4"), std::string(" -w5"), std::string(" w3 -w2") }) {
+            TestQuery query;
+            query.text = std::string("\"");
+            for (size_t i = 0; i < phrase.size(); ++i) {
+                query.plus_words.push_back(phrase[i]);
+                query.text += phrase[i] + std::string(i + 1 == phrase.size() ? "\"" : " with ");
+            }
+            if (slop >= 0) {
+                query.text += std::string("~") + std::to_string(slop);
+            }
+            query.text += extra_words;
+            if (extra_words == std::string(" w4")) {
+                query.plus_words.push_back("w4");
+            } else if (extra_words == std::string(" -w5")) {
+                query.minus_words.push_back("w5");
+            } else if (!extra_words.empty()) {
+                query.plus_words.push_back("w3");
+                query.minus_words.push_back("w2");
+            }
+            const auto has_phrase = [&corpus, &phrase, slop](int document_id) {
+                return HasPhraseExhaustive(corpus.at(document_id).words, phrase, slop);
+            };
+            const auto expected = FindTopDocumentsExhaustive(corpus, TfIdfScoring{}, query, [&has_phrase](int document_id, DocumentStatus, int) {
+                return has_phrase(document_id);
+            }, corpus.size());
+            const std::string query_name = std::string("query ") + query.text;
+            CheckSameDocuments(search_server.FindTopDocuments(std::execution::seq, query.text, predicate, corpus.size()), expected, query_name);
+            CheckSameDocuments(search_server.FindTopDocuments(std::execution::par, query.text, predicate, corpus.size()), expected, query_name);
+            const auto expected_top = FindTopDocumentsExhaustive(corpus, TfIdfScoring{}, query, [&has_phrase](int document_id, DocumentStatus status, int) {
+                return status == DocumentStatus::ACTUAL && has_phrase(document_id);
+            }, 5);
+            CheckSameDocuments(search_server.FindTopDocuments(query.text), expected_top, query_name + std::string(", top 5"));
+            if (extra_words.empty() && phrase.back() != std::string("w7")) {
+                Check(!expected.empty(), query_name + std::string(": no document has the phrase, the test corpus is too small"));
+            }
+        }
+    }
+}
+
+void TestMatchDocuments() {
+    constexpr size_t VOCABULARY_SIZE = 15;
+    std::mt19937 generator(29);
+    SearchServer search_server(TEST_STOP_WORDS);
+    search_server.SetPositionIndexing(true);
+    TestCorpus corpus;
+    for (int document_id = 0; document_id < 500; ++document_id) {
+        AddTestDocument(search_server, corpus, document_id, generator, VOCABULARY_SIZE);
+    }
+    std::vector<int> removed_ids;
+    for (int document_id = 0; document_id < 500; document_id += 9) {
+        RemoveTestDocument(search_server, corpus, document_id);
+        removed_ids.push_back(document_id);
+    }
+    const auto check_throws = [](const std::function<void()>& match, const std::string& name) {
+        bool is_thrown = false;
+        try {
+            match();
+        } catch (const std::out_of_range&) {
+            is_thrown = true;
+        }
+        Check(is_thrown, name + std::string(": removed document was matched"));
+    };
+    for (int query_index = 0; query_index < 60; ++query_index) {
+        TestQuery query = MakeTestQuery(generator, VOCABULARY_SIZE);
+        if (query_index % 4 == 0) {
+            query.text += std::string(" \"w0 w1\"~2");
+        }
+        // live documents in random order, some twice
+        std::vector<int> document_ids;
+        for (int i = 0; i < 100; ++i) {
+            document_ids.push_back(std::next(corpus.begin(), generator() % corpus.size())->first);
+        }
+        const std::string query_name = std::string("query") + query.text;
+        const auto results = search_server.MatchDocuments(query.text, document_ids);
+        const auto seq_results = search_server.MatchDocuments(std::execution::seq, query.text, document_ids);
+        const auto par_results = search_server.MatchDocuments(std::execution::par, query.text, document_ids);
+        Check(results.size() == document_ids.size() && seq_results == results && par_results == results,
+            query_name + std::string(": policies match differently"));
+        for (size_t i = 0; i < document_ids.size(); ++i) {
+            const std::string document_name = query_name + std::string(", document ") + std::to_string(document_ids[i]);
+            Check(results[i] == search_server.MatchDocument(query.text, document_ids[i]), document_name + std::string(": differs from MatchDocument"));
+            // without a phrase, the plus words of the document ordered by word, none if it has a minus word
+            const TestDocument& document = corpus.at(document_ids[i]);
+            const auto has_word = [&document](const std::string& word) {
+                return std::count(document.words.begin(), document.words.end(), word) > 0;
+            };
+            if (query_index % 4 != 0) {
+                std::vector<std::string> expected_words;
+                if (std::none_of(query.minus_words.begin(), query.minus_words.end(), has_word)) {
+                    std::copy_if(query.plus_words.begin(), query.plus_words.end(), std::back_inserter(expected_words), has_word);
+                    std::sort(expected_words.begin(), expected_words.end());
+                    expected_words.erase(std::unique(expected_words.begin(), expected_words.end()), expected_words.end());
+                }
+                const auto& [words, status] = results[i];
+                Check(std::equal(words.begin(), words.end(), expected_words.begin(), expected_words.end()) && status == document.status,
+                    document_name + std::string(": unexpected match"));
+            }
+        }
+        const int removed_id = removed_ids[generator() % removed_ids.size()];
+        check_throws([&] {
+            search_server.MatchDocument(query.text, removed_id);
+        }, query_name);
+        document_ids[generator() % document_ids.size()] = removed_id;
+        check_throws([&] {
+            search_server.MatchDocuments(query.text, document_ids);
+        }, query_name);
+        check_throws([&] {
+            search_server.MatchDocuments(std::execution::par, query.text, document_ids);
+        }, query_name);
+    }
+}
+
+void TestRequestQueue() {
+    std::mt19937 generator(31);
+    SearchServer search_server(TEST_STOP_WORDS);
+    for (int document_id = 0; document_id < 100; ++document_id) {
+        auto [document, text] = MakeTestDocument(generator, 10);
+        search_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, { document.rating });
+    }
+    // w10 and w11 are in no document
+    const std::string empty_query("w10 w11");
+    const std::string found_query("w0 w1 w2 w3");
+    for (const size_t window_length : { size_t{ 1 }, size_t{ 2 }, size_t{ 7 }, size_t{ 64 }, RequestQueue::DEFAULT_WINDOW_LENGTH }) {
+        const std::string name = std::string("window ") + std::to_string(window_length);
+        RequestQueue request_queue(search_server, window_length);
+        // the baseline kept the results of the last window_length requests in a deque
+        std::deque<bool> requests;
+        int empty_count = 0;
+        for (size_t i = 0; i < 5 * window_length + 10; ++i) {
+            const bool is_empty = generator() % 3 == 0;
+            const size_t overload = generator() % 3;
+            const std::string query = is_empty ? empty_query : found_query;
+            const auto result = overload == 0 ? request_queue.AddFindRequest(query)
+                : overload == 1 ? request_queue.AddFindRequest(query, DocumentStatus::ACTUAL)
+                : request_queue.AddFindRequest(query, [](int, DocumentStatus status, int) {
+                    return status == DocumentStatus::ACTUAL;
+                });
+            Check(result.empty() == is_empty, name + std::string(": unexpected search result"));
+            requests.push_back(is_empty);
+            empty_count += is_empty ? 1 : 0;
+            if (requests.size() > window_length) {
+                empty_count -= requests.front() ? 1 : 0;
+                requests.pop_front();
+            }
+            Check(request_queue.GetNoResultRequests() == empty_count, name + std::string(", request ") + std::to_string(i)
+                + std::string(": got ") + std::to_string(request_queue.GetNoResultRequests()) + std::string(" empty requests, expected ")
+                + std::to_string(empty_count));
+        }
+        const auto stats = request_queue.GetStats();
+        Check(stats.requests == 5 * window_length + 10, name + std::string(": requests missing from the time window"));
+    }
+
+    // whatever the interleaving, a window filled by requests of one kind counts only them
+    RequestQueue request_queue(search_server, 100);
+    for (const bool is_empty : { true, false, true }) {
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < 4; ++thread) {
+            threads.emplace_back([&request_queue, &empty_query, &found_query, is_empty] {
+                for (int i = 0; i < 60; ++i) {
+                    request_queue.AddFindRequest(is_empty ? empty_query : found_query);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        Check(request_queue.GetNoResultRequests() == (is_empty ? 100 : 0), std::string("concurrent requests counted wrongly"));
+    }
+}
+
+void TestResultCache() {
+    // keys with equal low bits still spread over the shards: 256 of them fit 16 shards of 64 entries
+    ConcurrentLruCache<int, int> cache(1024, 16);
+    for (int key = 0; key < 256; ++key) {
+        cache.Insert(key * 16, key);
+    }
+    Check(cache.GetStats().evictions == 0 && cache.GetStats().size == 256, std::string("keys crowd into few cache shards"));
+    for (int key = 0; key < 256; ++key) {
+        Check(cache.Find(key * 16) == key, std::string("cached value lost"));
+    }
+
+    std::mt19937 generator(37);
+    SearchServer cached_server(TEST_STOP_WORDS);
+    SearchServer search_server(TEST_STOP_WORDS);
+    cached_server.SetResultCacheCapacity(1000);
+    const auto add_document = [&](int document_id) {
+        auto [document, text] = MakeTestDocument(generator, 8);
+        cached_server.AddDocument(document_id, text, document.status, { document.rating });
+        search_server.AddDocument(document_id, text, document.status, { document.rating });
+    };
+    for (int document_id = 0; document_id < 200; ++document_id) {
+        add_document(document_id);
+    }
+    std::vector<std::string> queries;
+    for (int i = 0; i < 20; ++i) {
+        queries.push_back(MakeTestQuery(generator, 8).text);
+    }
+    const auto check_results = [&](const std::string& name) {
+        for (int pass = 0; pass < 2; ++pass) {
+            for (const std::string& query : queries) {
+                CheckSameDocuments(cached_server.FindTopDocuments(query), search_server.FindTopDocuments(query), name + std::string(", query") + query);
+                CheckSameDocuments(cached_server.FindTopDocuments(std::execution::par, query, DocumentStatus::BANNED),
+                    search_server.FindTopDocuments(query, DocumentStatus::BANNED), name + std::string(", banned, query") + query);
+            }
+            const auto results = cached_server.FindTopDocumentsBatch(queries);
+            for (size_t i = 0; i < queries.size(); ++i) {
+                CheckSameDocuments(results[i], search_server.FindTopDocuments(queries[i]), name + std::string(", batch, query") + queries[i]);
+            }
+        }
+    };
+    check_results(std::string("initial"));
+    const uint64_t hits = cached_server.GetResultCacheStats().hits;
+    check_results(std::string("cached"));
+    Check(cached_server.GetResultCacheStats().hits > hits, std::string("repeated queries missed the cache"));
+
+    // every update retires the cached results; the top documents are removed so that results change
+    const auto find_top_id = [&search_server](const std::string& query, int default_id) {
+        const auto documents = search_server.FindTopDocuments(query);
+        return documents.empty() ? default_id : documents.front().id;
+    };
+    for (int round = 0; round < 3; ++round) {
+        add_document(200 + round);
+        check_results(std::string("after AddDocument"));
+        const int top_id = find_top_id(queries[round], round);
+        cached_server.RemoveDocument(top_id);
+        search_server.RemoveDocument(top_id);
+        check_results(std::string("after RemoveDocument"));
+        const int next_top_id = find_top_id(queries[round], 100 + round);
+        cached_server.RemoveDocument(std::execution::par, next_top_id);
+        search_server.RemoveDocument(next_top_id);
+        check_results(std::string("after parallel RemoveDocument"));
+        const std::vector<SearchServer::NewDocument> batch = {
+            { 300 + 2 * round, queries[round], DocumentStatus::ACTUAL, { 100 } },
+            { 301 + 2 * round, queries[round + 1], DocumentStatus::BANNED, { 100 } },
+        };
+        cached_server.AddDocuments(batch);
+        search_server.AddDocuments(batch);
+        check_results(std::string("after AddDocuments"));
+    }
+}
+
+void TestFindTopDocumentsBatch() {
+    constexpr size_t VOCABULARY_SIZE = 20;
+    std::mt19937 generator(43);
+    SearchServer search_server(TEST_STOP_WORDS);
+    search_server.SetPositionIndexing(true);
+    TestCorpus corpus;
+    // gaps in the docids leave empty blocks and parts
+    for (int i = 0; i < 6000; ++i) {
+        AddTestDocument(search_server, corpus, i < 3000 ? i : 2 * i + 5000, generator, VOCABULARY_SIZE, 0.3);
+    }
+    search_server.Compact(PostingFormat::COMPRESSED);
+    for (int i = 0; i < 200; ++i) {
+        RemoveTestDocument(search_server, corpus, 13 * i);
+        AddTestDocument(search_server, corpus, 20000 + i, generator, VOCABULARY_SIZE);
+    }
+    // overlapping and repeated queries, phrases, a phrase word missing from the index (w30) and a query
+    // sharing no word with the others
+    std::vector<std::string> queries;
+    for (int i = 0; i < 40; ++i) {
+        queries.push_back(MakeTestQuery(generator, VOCABULARY_SIZE).text);
+    }
+    for (const std::string query : { "\"w0 w1\" w2", "\"w1 w0\"~2 -w3", "w0 \"w2 w30\"", "w25", "w1 w0 w2", "w2 w0 w1" }) {
+        queries.push_back(query);
+    }
+    queries.push_back(queries[3]);
+    queries.push_back(queries[0]);
+    const auto find_expected = [&](DocumentStatus status, size_t top_count) {
+        std::vector<std::vector<Document>> expected;
+        for (const std::string& query : queries) {
+            expected.push_back(search_server.FindTopDocuments(query, status, top_count));
+        }
+        return expected;
+    };
+    const auto check_batch = [&](const std::vector<std::vector<Document>>& expected, DocumentStatus status, size_t top_count,
+        const std::string& name) {
+        const auto results = search_server.FindTopDocumentsBatch(queries, status, top_count);
+        Check(results.size() == queries.size(), name + std::string(": one result per query expected"));
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const std::string query_name = name + std::string(", query ") + queries[i];
+            CheckSameDocuments(results[i], expected[i], query_name);
+            for (size_t j = 0; j < expected[i].size(); ++j) {
+                Check(results[i][j].relevance == expected[i][j].relevance, query_name + std::string(": relevance differs in the last bits"));
+            }
+        }
+    };
+    for (const size_t top_count : { size_t(5), corpus.size() }) {
+        for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+            check_batch(find_expected(status, top_count), status, top_count, std::string("top ") + std::to_string(top_count));
+        }
+    }
+    // cached results are taken as they are, the remaining queries are still scored together
+    const auto expected = find_expected(DocumentStatus::ACTUAL, 5);
+    search_server.SetResultCacheCapacity(100);
+    search_server.FindTopDocumentsBatch(std::vector<std::string>(queries.begin(), queries.begin() + 10), DocumentStatus::ACTUAL, 5);
+    check_batch(expected, DocumentStatus::ACTUAL, 5, std::string("partly cached"));
+    check_batch(expected, DocumentStatus::ACTUAL, 5, std::string("cached"));
+    Check(search_server.FindTopDocumentsBatch({}).empty(), std::string("empty batch has results"));
+}
+
+void TestDocIdBitmap() {
+    std::mt19937 generator(41);
+    DocIdBitmap bitmap;
+    std::set<int> expected;
+    const auto check_same = [&bitmap, &expected, &generator](const std::string& name) {
+        Check(bitmap.Size() == expected.size(), name + std::string(": sizes differ"));
+        for (int i = 0; i < 200; ++i) {
+            const int document_id = static_cast<int>(generator() % 140000);
+            Check(bitmap.Contains(document_id) == (expected.count(document_id) > 0), name + std::string(": membership differs"));
+            int64_t next_absent = document_id;
+            while (expected.count(static_cast<int>(next_absent)) > 0) {
+                ++next_absent;
+            }
+            Check(bitmap.NextAbsent(document_id) == next_absent, name + std::string(": NextAbsent differs"));
+        }
+    };
+    const auto add = [&bitmap, &expected](int document_id) {
+        Check(bitmap.Add(document_id) == expected.insert(document_id).second, std::string("Add result differs"));
+    };
+    const auto remove = [&bitmap, &expected](int document_id) {
+        Check(bitmap.Remove(document_id) == (expected.erase(document_id) > 0), std::string("Remove result differs"));
+    };
+
+    // the first group grows into a bitset, the second stays an array, the third is dense
+    for (size_t i = 0; i <= DocIdBitmap::ARRAY_MAX_SIZE; ++i) {
+        add(static_cast<int>(i * 15));
+        add(65536 + static_cast<int>(generator() % 65536));
+    }
+    for (int i = 0; i < 65536; ++i) {
+        add(131072 + i);
+    }
+    check_same(std::string("grown"));
+    // a size hovering around the array limit keeps the bitset, shrinking to BITSET_MIN_SIZE turns it back
+    const size_t bitset_bytes = bitmap.MemoryUsage();
+    for (int round = 0; round < 10; ++round) {
+        remove(15);
+        Check(bitmap.MemoryUsage() == bitset_bytes, std::string("bitset converted right below the array limit"));
+        add(15);
+    }
+    check_same(std::string("hovering"));
+    for (size_t i = 0; i < DocIdBitmap::ARRAY_MAX_SIZE - DocIdBitmap::BITSET_MIN_SIZE; ++i) {
+        remove(static_cast<int>(i * 15));
+    }
+    Check(bitmap.MemoryUsage() == bitset_bytes, std::string("bitset converted above BITSET_MIN_SIZE"));
+    remove(static_cast<int>(DocIdBitmap::ARRAY_MAX_SIZE * 15));
+    Check(bitmap.MemoryUsage() < bitset_bytes, std::string("bitset not converted back to an array"));
+    check_same(std::string("shrunk"));
+    for (int i = 0; i < 20000; ++i) {
+        const int document_id = static_cast<int>(generator() % 140000);
+        if (generator() % 2 == 0) {
+            add(document_id);
+        } else {
+            remove(document_id);
+        }
+    }
+    check_same(std::string("random updates"));
+}
+
+void TestMinusWordBitmaps() {
+    constexpr size_t VOCABULARY_SIZE = 40;
+    std::mt19937 generator(43);
+    SearchServer search_server(TEST_STOP_WORDS);
+    TestCorpus corpus;
+    for (int document_id = 0; document_id < 10000; ++document_id) {
+        AddTestDocument(search_server, corpus, document_id, generator, VOCABULARY_SIZE, 0.7);
+    }
+    // w0 and w1 are in more than BITMAP_MIN_SIZE documents and exclude through their bitmaps, w2 and w3
+    // in fewer and exclude through cursors; every query has minus words of both kinds
+    const auto document_freq = [&corpus](const std::string& word) {
+        return std::count_if(corpus.begin(), corpus.end(), [&word](const auto& entry) {
+            return std::count(entry.second.words.begin(), entry.second.words.end(), word) > 0;
+        });
+    };
+    Check(document_freq("w1") > static_cast<int64_t>(PostingList::BITMAP_MIN_SIZE) && document_freq("w2") < static_cast<int64_t>(PostingList::BITMAP_MIN_SIZE),
+        std::string("unexpected word frequencies"));
+    const auto check_queries = [&](const std::string& name) {
+        const auto predicate = [](int, DocumentStatus status, int) {
+            return status != DocumentStatus::REMOVED;
+        };
+        for (int query_index = 0; query_index < 30; ++query_index) {
+            TestQuery query = MakeTestQuery(generator, VOCABULARY_SIZE);
+            query.minus_words.push_back(TestWord(generator() % 2));
+            query.minus_words.push_back(TestWord(2 + generator() % 2));
+            query.text += std::string(" -") + query.minus_words[query.minus_words.size() - 2] + std::string(" -") + query.minus_words.back();
+            const std::string query_name = name + std::string(", query") + query.text;
+            const auto expected = FindTopDocumentsExhaustive(corpus, TfIdfScoring{}, query, predicate, corpus.size());
+            CheckSameDocuments(search_server.FindTopDocuments(std::execution::seq, query.text, predicate, corpus.size()), expected, query_name);
+            CheckSameDocuments(search_server.FindTopDocuments(std::execution::par, query.text, predicate, corpus.size()), expected, query_name);
+        }
+    };
+    check_queries(std::string("appended"));
+    // w1 documents are removed until its bitmap group is an array and added back, then again
+    std::vector<int> w1_ids;
+    for (const auto& [document_id, document] : corpus) {
+        if (std::count(document.words.begin(), document.words.end(), std::string("w1")) > 0) {
+            w1_ids.push_back(document_id);
+        }
+    }
+    for (int round = 0; round < 2; ++round) {
+        std::vector<std::pair<int, TestDocument>> removed;
+        while (w1_ids.size() > DocIdBitmap::BITSET_MIN_SIZE - 100) {
+            const int document_id = w1_ids.back();
+            w1_ids.pop_back();
+            removed.emplace_back(document_id, corpus.at(document_id));
+            RemoveTestDocument(search_server, corpus, document_id);
+        }
+        check_queries(std::string("shrunk, round ") + std::to_string(round));
+        for (auto& [document_id, document] : removed) {
+            std::string text;
+            for (const std::string& word : document.words) {
+                text += word + std::string(" ");
+            }
+            search_server.AddDocument(document_id, text, document.status, { document.rating });
+            corpus[document_id] = std::move(document);
+            w1_ids.push_back(document_id);
+        }
+        check_queries(std::string("regrown, round ") + std::to_string(round));
+    }
+}
+
+void TestSplitIntoWords() {
+    const auto check_split = [](const std::string_view text, const std::string& name) {
+        const auto [expected_words, expected_invalid] = SplitIntoWordsScalar(text);
+        std::vector<std::string_view> words{ "stale" };
+        const size_t first_invalid = SplitIntoWords(text, words);
+        Check(words == expected_words && first_invalid == expected_invalid, name + std::string(": words differ from the scalar splitter"));
+        std::pmr::vector<std::string_view> pmr_words;
+        Check(SplitIntoWords(text, pmr_words) == expected_invalid && std::equal(pmr_words.begin(), pmr_words.end(),
+            expected_words.begin(), expected_words.end()), name + std::string(": pmr words differ from the scalar splitter"));
+        Check(SplitIntoWords(text) == expected_words, name + std::string(": returned words differ from the scalar splitter"));
+    };
+    const std::vector<std::string> texts = {
+        "", " ", "cat", "fifteen bytes!!", "sixteen bytes!!!", "seventeen bytes!!", "exactly sixteen ",
+        "               a", "                ", "                 ", "a                ", "  a  b   c    d     e      ",
+        // words crossing the 16-byte boundary, once and twice
+        "fourteen bytes crossing_the_boundary", "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz0123456789",
+        "a b c d e f g h i j k l m n o p q r s t u v w x y z",
+        // control characters and bytes above 127, which are not control characters
+        "cat\tdog", "sixteen bytes!\x01 next", "fifteen bytes!! \x1f", "\x7f\x80\xff caf\xc3\xa9", "valid words then an invalid\x0bone",
+    };
+    for (const std::string& text : texts) {
+        check_split(text, std::string("text \"") + text + std::string("\""));
+    }
+    // every length around the block size, at every alignment, from a few characters
+    std::mt19937 generator(47);
+    const std::string alphabet("  ab\x01\x1f\x7f\xff");
+    for (size_t size = 0; size <= 50; ++size) {
+        for (int trial = 0; trial < 100; ++trial) {
+            std::string buffer(size + 16, 'x');
+            for (char& c : buffer) {
+                c = alphabet[generator() % alphabet.size()];
+            }
+            const size_t offset = generator() % 16;
+            check_split(std::string_view(buffer).substr(offset, size), std::string("random text of ") + std::to_string(size) + std::string(" bytes"));
+        }
+    }
+
+    // words with control characters are rejected in documents and queries, stop words included
+    SearchServer search_server(TEST_STOP_WORDS);
+    for (const std::string text : { "cat\tdog", "sixteen bytes!!!\x01", "in\n", "              fluffy\x1f cat" }) {
+        bool is_document_rejected = false;
+        try {
+            search_server.AddDocument(1, text, DocumentStatus::ACTUAL, { 1 });
+        } catch (const std::invalid_argument&) {
+            is_document_rejected = true;
+        }
+        bool is_query_rejected = false;
+        try {
+            search_server.FindTopDocuments(text);
+        } catch (const std::invalid_argument&) {
+            is_query_rejected = true;
+        }
+        Check(is_document_rejected && is_query_rejected && search_server.GetDocumentCount() == 0,
+            std::string("control character accepted in \"") + text + std::string("\""));
+    }
+}
+
+void TestPerfectHashSet() {
+    // the two words have the same 64-bit FNV-1a hash under the first seed, so the set has to reseed
+    const std::vector<std::string_view> colliding_words = { "NTSE04pvvYj", "7dixCZiBfbc" };
+    const std::vector<std::string_view> missing_words = { "NTSE04pvvYk", "7dixCZiBfb", "", "and", "NTSE04pvvYj7dixCZiBfbc" };
+    for (const size_t extra_count : { size_t{ 0 }, size_t{ 1 }, size_t{ 100 } }) {
+        std::vector<std::string> extra_words;
+        for (size_t i = 0; i < extra_count; ++i) {
+            extra_words.push_back(TestWord(i));
+        }
+        std::vector<std::string_view> words(extra_words.begin(), extra_words.end());
+        words.insert(words.end(), colliding_words.begin(), colliding_words.end());
+        // duplicates and empty strings are dropped
+        words.push_back(colliding_words.front());
+        words.push_back(std::string_view());
+        const PerfectHashSet set(words);
+        const std::string name = std::string("colliding words with ") + std::to_string(extra_count) + std::string(" others");
+        Check(set.Size() == extra_count + colliding_words.size(), name + std::string(": wrong size"));
+        for (const std::string_view word : words) {
+            Check(word.empty() != set.Contains(word), name + std::string(": word ") + std::string(word) + std::string(" not found"));
+        }
+        for (const std::string_view word : missing_words) {
+            Check(!set.Contains(word), name + std::string(": word ") + std::string(word) + std::string(" found"));
+        }
+        Check(!set.Contains(TestWord(extra_count)), name + std::string(": word ") + TestWord(extra_count) + std::string(" found"));
+    }
+
+    // random sets against std::set
+    std::mt19937 generator(53);
+    for (const size_t size : { size_t{ 1 }, size_t{ 2 }, size_t{ 17 }, size_t{ 1000 } }) {
+        std::set<std::string> expected;
+        while (expected.size() < size) {
+            std::string word(1 + generator() % 6, 'a');
+            for (char& c : word) {
+                c = static_cast<char>('a' + generator() % 4);
+            }
+            expected.insert(word);
+        }
+        const PerfectHashSet set(std::vector<std::string_view>(expected.begin(), expected.end()));
+        Check(set.Size() == size, std::string("random set: wrong size"));
+        for (int i = 0; i < 2000; ++i) {
+            std::string word(1 + generator() % 7, 'a');
+            for (char& c : word) {
+                c = static_cast<char>('a' + generator() % 4);
+            }
+            Check(set.Contains(word) == (expected.count(word) > 0), std::string("random set: membership of ") + word + std::string(" differs"));
+        }
+    }
+
+    // colliding stop words are both left out of documents and queries
+    SearchServer search_server(std::string("NTSE04pvvYj 7dixCZiBfbc"));
+    search_server.AddDocument(1, "NTSE04pvvYj cat 7dixCZiBfbc", DocumentStatus::ACTUAL, { 1 });
+    Check(search_server.GetWordFrequencies(1).size() == 1 && search_server.FindTopDocuments("NTSE04pvvYj 7dixCZiBfbc").empty(),
+        std::string("colliding stop words indexed"));
+    const auto [matched_words, status] = search_server.MatchDocument("NTSE04pvvYj cat 7dixCZiBfbc", 1);
+    Check(matched_words == std::vector<std::string_view>{ "cat" }, std::string("colliding stop words matched"));
+}
+
+void TestShardedSearchServer() {
+    constexpr size_t VOCABULARY_SIZE = 20;
+    std::mt19937 generator(59);
+    std::vector<std::unique_ptr<SearchShard>> shards;
+#ifndef _WIN32
+    shards.push_back(StartShardProcess(TEST_STOP_WORDS));
+    shards.push_back(StartShardProcess(TEST_STOP_WORDS));
+#endif
+    shards.push_back(std::make_unique<LocalShard>(TEST_STOP_WORDS));
+    ShardedSearchServer mixed_server(std::move(shards));
+    ShardedSearchServer local_server(TEST_STOP_WORDS, 4);
+    SearchServer search_server(TEST_STOP_WORDS);
+    std::vector<int> document_ids;
+    for (int i = 0; i < 600; ++i) {
+        const int document_id = i * 7 % 1000;
+        auto [document, text] = MakeTestDocument(generator, VOCABULARY_SIZE);
+        const std::vector<int> ratings = { document.rating, -3, 8 };
+        mixed_server.AddDocument(document_id, text, document.status, ratings);
+        local_server.AddDocument(document_id, text, document.status, ratings);
+        search_server.AddDocument(document_id, text, document.status, ratings);
+        document_ids.push_back(document_id);
+    }
+    for (int i = 0; i < 100; ++i) {
+        const int document_id = document_ids[generator() % document_ids.size()];
+        mixed_server.RemoveDocument(document_id);
+        local_server.RemoveDocument(document_id);
+        search_server.RemoveDocument(document_id);
+    }
+    // the word frequencies of the shards differ, only the global statistics give single-index relevance
+    for (const ShardedSearchServer* server : { &mixed_server, &local_server }) {
+        const std::string name = server == &mixed_server ? std::string("processes and a local shard") : std::string("local shards");
+        Check(server->GetDocumentCount() == search_server.GetDocumentCount(), name + std::string(": document counts differ"));
+        for (int query_index = 0; query_index < 40; ++query_index) {
+            const TestQuery query = MakeTestQuery(generator, VOCABULARY_SIZE);
+            const size_t top_count = std::vector<size_t>{ 1, 3, 5, 20 }[generator() % 4];
+            const DocumentStatus status = static_cast<DocumentStatus>(generator() % 4);
+            CheckSameDocuments(server->FindTopDocuments(query.text, status, top_count), search_server.FindTopDocuments(query.text, status, top_count),
+                name + std::string(", query") + query.text + std::string(", top ") + std::to_string(top_count));
+        }
+        for (const int document_id : search_server) {
+            Check(server->MatchDocument("w0 w1 w2 -w7", document_id) == search_server.MatchDocument("w0 w1 w2 -w7", document_id),
+                name + std::string(": document ") + std::to_string(document_id) + std::string(" matched differently"));
+        }
+    }
+
+    // the protocol carries long and non-ASCII texts and brings errors back with their type and message
+    std::string long_text;
+    for (int i = 0; i < 20000; ++i) {
+        long_text += TestWord(i % 50) + std::string(" ");
+    }
+    long_text += std::string("caf\xc3\xa9");
+    mixed_server.AddDocument(1000, long_text, DocumentStatus::BANNED, {});
+    mixed_server.AddDocument(1001, long_text, DocumentStatus::BANNED, { 4 });
+    const auto [matched_words, status] = mixed_server.MatchDocument("w3 caf\xc3\xa9 w77", 1000);
+    Check(matched_words == std::vector<std::string_view>{ "caf\xc3\xa9", "w3" } && status == DocumentStatus::BANNED,
+        std::string("long document matched wrongly"));
+    const auto top_documents = mixed_server.FindTopDocuments("caf\xc3\xa9", DocumentStatus::BANNED);
+    Check(top_documents.size() == 2 && top_documents[0].id == 1001 && top_documents[0].rating == 4 && top_documents[1].rating == 0,
+        std::string("long documents found wrongly"));
+    // matched words stay valid after later calls
+    mixed_server.MatchDocument("w4 w5", 1001);
+    Check(matched_words == std::vector<std::string_view>{ "caf\xc3\xa9", "w3" }, std::string("matched words changed"));
+
+    const auto check_error = [](const std::function<void()>& call, const std::string& expected_type, const std::string& name) {
+        std::string type;
+        std::string message;
+        try {
+            call();
+        } catch (const std::invalid_argument& e) {
+            type = std::string("invalid_argument");
+            message = e.what();
+        } catch (const std::out_of_range& e) {
+            type = std::string("out_of_range");
+            message = e.what();
+        }
+        Check(type == expected_type && !message.empty(), name + std::string(": got ") + (type.empty() ? std::string("no error") : type));
+    };
+    // one document per shard, then calls failing on each shard
+    for (const int document_id : { 2000, 2001, 2002 }) {
+        const std::string name = std::string("shard ") + std::to_string(document_id % 3);
+        mixed_server.AddDocument(document_id, "w1", DocumentStatus::ACTUAL, { 1 });
+        check_error([&] {
+            mixed_server.AddDocument(document_id, "w1", DocumentStatus::ACTUAL, { 1 });
+        }, std::string("invalid_argument"), name + std::string(", duplicate id"));
+        check_error([&] {
+            mixed_server.AddDocument(document_id + 3, "w1 w\x01", DocumentStatus::ACTUAL, { 1 });
+        }, std::string("invalid_argument"), name + std::string(", control character"));
+        check_error([&] {
+            mixed_server.AddDocument(document_id + 3, "w1", static_cast<DocumentStatus>(DocumentColumns::STATUS_COUNT), { 1 });
+        }, std::string("invalid_argument"), name + std::string(", invalid status"));
+        check_error([&] {
+            mixed_server.MatchDocument("w1", document_id + 3);
+        }, std::string("out_of_range"), name + std::string(", missing document"));
+    }
+    check_error([&] {
+        mixed_server.FindTopDocuments("w1 --w2");
+    }, std::string("invalid_argument"), std::string("invalid query"));
+    Check(mixed_server.GetDocumentCount() == search_server.GetDocumentCount() + 2 + 3, std::string("failed calls changed the shards"));
+}
+
+void TestQueryAllocations() {
+#ifndef SEARCH_SERVER_COUNT_ALLOCATIONS
+    std::cerr << std::string("TestQueryAllocations skipped: build with SEARCH_SERVER_COUNT_ALLOCATIONS") << std::endl;
+#else
+    const std::string raw_query("curly nasty cat -collar");
+    for (const PostingFormat format : { PostingFormat::PLAIN, PostingFormat::COMPRESSED }) {
+        const SearchServer search_server = MakeTestServer(format);
+        const std::string suffix(format == PostingFormat::PLAIN ? " over plain lists" : " over compressed lists");
+        // the only allocation of a sequential query is its result
+        CheckAllocations(std::string("status query") + suffix, 1, [&] {
+            search_server.FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
+        });
+        CheckAllocations(std::string("predicate query") + suffix, 1, [&] {
+            search_server.FindTopDocuments(std::execution::seq, raw_query, [](int document_id, DocumentStatus, int) {
+                return document_id % 2 == 0;
+            });
+        });
+        CheckAllocations(std::string("BM25 query") + suffix, 1, [&] {
+            search_server.FindTopDocuments(std::execution::seq, Bm25Scoring{}, raw_query, DocumentStatus::ACTUAL);
+        });
+        // the TBB scheduler allocates once or twice more on the calling thread
+        CheckAllocations(std::string("parallel status query") + suffix, 3, [&] {
+            search_server.FindTopDocuments(std::execution::par, raw_query, DocumentStatus::ACTUAL);
+        });
+        CheckAllocations(std::string("parallel BM25 query") + suffix, 3, [&] {
+            search_server.FindTopDocuments(std::execution::par, Bm25Scoring{}, raw_query, DocumentStatus::ACTUAL);
+        });
+    }
+    std::cerr << std::string("TestQueryAllocations OK") << std::endl;
+#endif
+}
+
+void TestSearchServer() {
+    // shard workers are forked first, while the process has a single thread
+    TestShardedSearchServer();
+    TestTopDocumentsOrder();
+    TestFindTopDocumentsPruning();
+    TestPostingListCompression();
+    TestSnapshot();
+    TestInvalidDocumentStatus();
+    TestSegmentedSearchServer();
+    TestConcurrentSearchServerFailedUpdates();
+    TestPhraseQueries();
+    TestMatchDocuments();
+    TestRequestQueue();
+    TestResultCache();
+    TestFindTopDocumentsBatch();
+    TestDocIdBitmap();
+    TestMinusWordBitmaps();
+    TestSplitIntoWords();
+    TestPerfectHashSet();
+    TestQueryAllocations();
+    std::cerr << std::string("TestSearchServer OK") << std::endl;
+}
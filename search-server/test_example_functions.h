@@ -1,2 +1,65 @@
 #pragma once
-#include "string_processing.h"
\ No newline at end of file
+#include "string_processing.h"
+
+// The checks below throw std::logic_error describing the first failure.
+
+// Ranking ties come out as the baseline sort ordered them: relevance, then rating within epsilon, then docid
+void TestTopDocumentsOrder();
+// Block-max WAND returns what exhaustive scoring of every matched document does, over a random corpus
+// with plus and minus words, status and predicate filters, removed and re-added documents and many ties,
+// in plain and compressed posting lists; with TF-IDF and BM25 scoring
+void TestFindTopDocumentsPruning();
+// A compressed posting list yields the docids and bit-identical term frequencies of a plain one, through
+// cursors, SkipTo and Contains, also with tombstones and a delta
+void TestPostingListCompression();
+// A saved and loaded index answers queries as the original did, plain and compressed lists, tombstones,
+// deltas and positions included. Truncated snapshots are rejected, and a corrupted byte is either rejected
+// with std::runtime_error or leaves an index that can be searched.
+void TestSnapshot();
+// AddDocument and AddDocuments reject an out-of-range DocumentStatus before changing the index.
+void TestInvalidDocumentStatus();
+// A segmented index answers as a single SearchServer over the same documents while segments merge in the
+// background, with documents removed during merges and removed ids added again.
+void TestSegmentedSearchServer();
+// Both copies of a ConcurrentSearchServer agree with a plain SearchServer after updates that throw,
+// on the first copy (duplicate ids) or on the second one after changing it.
+void TestConcurrentSearchServerFailedUpdates();
+// Exact phrases and unordered windows ("a b", "a b"~N, "a a"~N), with words missing from the matched
+// documents or from the whole index, against a scan of the documents' words.
+void TestPhraseQueries();
+// MatchDocuments, sequential and parallel, returns what MatchDocument does for each document, minus words
+// and phrases included, and throws std::out_of_range as it does for removed documents.
+void TestMatchDocuments();
+// RequestQueue counts requests without results over the last window_length ones as the deque it replaced
+// did, through many wraparounds of the ring and with requests from several threads.
+void TestRequestQueue();
+// Cache shards are chosen by a mixed hash. Cached results are retired by the index generation: after
+// AddDocument, AddDocuments and RemoveDocument the cached server answers as one without a cache.
+void TestResultCache();
+// FindTopDocumentsBatch answers each query, repeated and overlapping ones, phrases and minus words
+// included, with the documents and bit-identical relevances of FindTopDocuments, with and without cached results.
+void TestFindTopDocumentsBatch();
+// DocIdBitmap answers membership and NextAbsent as a std::set does while groups turn from arrays into
+// bitsets and back; a group hovering around ARRAY_MAX_SIZE stays a bitset.
+void TestDocIdBitmap();
+// Minus words excluded through posting bitmaps and through cursors give the results of exhaustive
+// scoring, also after a bitmap shrinks below its array threshold and grows back.
+void TestMinusWordBitmaps();
+// The block-scanning SplitIntoWords splits and finds control characters as the scalar splitter does,
+// around and across the 16-byte block size; documents and queries with control characters are rejected.
+void TestSplitIntoWords();
+// PerfectHashSet holds words whose hashes collide under the first seed, as a set and as stop words,
+// and answers membership as std::set does.
+void TestPerfectHashSet();
+// Sharded servers, of local shards and of forked worker processes, answer as a single index: relevance
+// comes from the document frequencies of all shards. The worker protocol carries long and non-ASCII
+// texts and returns errors with their type.
+void TestShardedSearchServer();
+// Checks that warmed-up queries allocate nothing on the heap but the returned vector, plus what the TBB
+// scheduler allocates for parallel ones: sequential status, predicate and BM25 queries over plain and
+// compressed posting lists. Only builds defining SEARCH_SERVER_COUNT_ALLOCATIONS count allocations; other
+// builds skip the test.
+void TestQueryAllocations();
+
+// Runs all of the above
+void TestSearchServer();
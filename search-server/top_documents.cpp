@@ -0,0 +1,48 @@
+#include "top_documents.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+TopDocuments::TopDocuments(size_t capacity, std::pmr::memory_resource* resource)
+    : capacity_(capacity)
+    , heap_(resource) {
+    heap_.reserve(capacity);
+}
+
+void TopDocuments::Push(const Document& document) {
+    if (heap_.size() < capacity_) {
+        heap_.push_back(document);
+        std::push_heap(heap_.begin(), heap_.end(), IsBetter);
+    } else if (capacity_ > 0 && IsBetter(document, heap_.front())) {
+        std::pop_heap(heap_.begin(), heap_.end(), IsBetter);
+        heap_.back() = document;
+        std::push_heap(heap_.begin(), heap_.end(), IsBetter);
+    }
+}
+
+double TopDocuments::Threshold() const {
+    if (capacity_ == 0) {
+        return std::numeric_limits<double>::infinity();
+    }
+    if (heap_.size() < capacity_) {
+        return -std::numeric_limits<double>::infinity();
+    }
+    return heap_.front().relevance;
+}
+
+std::vector<Document> TopDocuments::Extract() {
+    std::sort_heap(heap_.begin(), heap_.end(), IsBetter);
+    std::vector<Document> result(heap_.begin(), heap_.end());
+    heap_.clear();
+    return result;
+}
+
+bool TopDocuments::IsBetter(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < std::numeric_limits<double>::epsilon()) {
+        if (lhs.rating != rhs.rating) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    }
+    return lhs.relevance > rhs.relevance;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+#include "document.h"
+
+// Keeps the best `capacity` documents seen so far in a bounded heap whose front is the worst kept one.
+// Ranking: higher relevance first, ratings break ties within epsilon relevance, then smaller ids come first.
+class TopDocuments {
+public:
+    // the heap lives in resource, the extracted documents don't
+    explicit TopDocuments(size_t capacity, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    void Push(const Document& document);
+    // Relevance a document has to reach to be kept: -inf until the collector is full
+    double Threshold() const;
+    // Returns the kept documents best-first and leaves the collector empty
+    std::vector<Document> Extract();
+
+    static bool IsBetter(const Document& lhs, const Document& rhs);
+
+private:
+    size_t capacity_;
+    std::pmr::vector<Document> heap_;
+};
@@ -0,0 +1,143 @@
+#include "word_positions.h"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+DocumentPositions::DocumentPositions(const std::vector<TermId>& word_terms) {
+    std::vector<uint32_t> order(word_terms.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&word_terms](uint32_t lhs, uint32_t rhs) {
+        return word_terms[lhs] < word_terms[rhs];
+    });
+    uint32_t prev = 0;
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (i > 0 && word_terms[order[i - 1]] != word_terms[order[i]]) {
+            offsets_.push_back(static_cast<uint32_t>(data_.size()));
+            prev = 0;
+        }
+        uint32_t gap = order[i] - prev;
+        prev = order[i];
+        while (gap >= 0x80) {
+            data_.push_back(static_cast<uint8_t>(gap | 0x80));
+            gap >>= 7;
+        }
+        data_.push_back(static_cast<uint8_t>(gap));
+    }
+    if (!order.empty()) {
+        offsets_.push_back(static_cast<uint32_t>(data_.size()));
+    }
+    offsets_.shrink_to_fit();
+    data_.shrink_to_fit();
+}
+
+DocumentPositions::DocumentPositions(std::vector<uint32_t> offsets, std::vector<uint8_t> data)
+    : offsets_(std::move(offsets)), data_(std::move(data)) {
+    if (offsets_.empty() || offsets_.front() != 0 || offsets_.back() != data_.size()
+        || !std::is_sorted(offsets_.begin(), offsets_.end())) {
+        throw std::invalid_argument(std::string("Invalid word positions"));
+    }
+}
+
+size_t DocumentPositions::TermCount() const {
+    return offsets_.size() - 1;
+}
+
+void DocumentPositions::Decode(size_t term_index, std::vector<uint32_t>& positions) const {
+    positions.clear();
+    uint32_t position = 0;
+    uint32_t gap = 0;
+    int shift = 0;
+    for (uint32_t pos = offsets_[term_index]; pos < offsets_[term_index + 1]; ++pos) {
+        gap |= static_cast<uint32_t>(data_[pos] & 0x7F) << shift;
+        if (data_[pos] & 0x80) {
+            shift += 7;
+            continue;
+        }
+        position += gap;
+        positions.push_back(position);
+        gap = 0;
+        shift = 0;
+    }
+}
+
+const std::vector<uint32_t>& DocumentPositions::Offsets() const {
+    return offsets_;
+}
+
+const std::vector<uint8_t>& DocumentPositions::Data() const {
+    return data_;
+}
+
+size_t DocumentPositions::MemoryUsage() const {
+    return offsets_.capacity() * sizeof(uint32_t) + data_.capacity();
+}
+
+bool HasPhrase(std::span<const std::vector<uint32_t>> positions) {
+    if (positions.empty()) {
+        return true;
+    }
+    // every word keeps a cursor that only moves forward, as candidate starts only grow
+    std::vector<size_t> cursors(positions.size(), 0);
+    for (const uint32_t start : positions[0]) {
+        bool is_match = true;
+        for (size_t word = 1; word < positions.size() && is_match; ++word) {
+            const auto& word_positions = positions[word];
+            size_t& cursor = cursors[word];
+            while (cursor < word_positions.size() && word_positions[cursor] < start + word) {
+                ++cursor;
+            }
+            if (cursor == word_positions.size()) {
+                return false;
+            }
+            is_match = word_positions[cursor] == start + word;
+        }
+        if (is_match) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HasWindow(std::span<const std::vector<uint32_t>> positions, uint32_t slop) {
+    // a repeated word has the same positions every time; it needs that many distinct occurrences in the window
+    struct WindowWord {
+        const std::vector<uint32_t>* positions;
+        size_t count;
+    };
+    std::vector<WindowWord> words;
+    for (const auto& word_positions : positions) {
+        const auto it = std::find_if(words.begin(), words.end(), [&word_positions](const WindowWord& word) {
+            return *word.positions == word_positions;
+        });
+        if (it == words.end()) {
+            words.push_back({ &word_positions, 1 });
+        } else {
+            ++it->count;
+        }
+    }
+    // slides over the smallest window holding count consecutive occurrences of every word
+    std::vector<size_t> cursors(words.size(), 0);
+    const uint64_t max_span = positions.size() + uint64_t{ slop } - 1;
+    while (true) {
+        size_t min_word = 0;
+        uint32_t min_position = UINT32_MAX;
+        uint32_t max_position = 0;
+        for (size_t word = 0; word < words.size(); ++word) {
+            const auto& word_positions = *words[word].positions;
+            if (cursors[word] + words[word].count > word_positions.size()) {
+                return false;
+            }
+            const uint32_t first = word_positions[cursors[word]];
+            if (first < min_position) {
+                min_position = first;
+                min_word = word;
+            }
+            max_position = std::max(max_position, word_positions[cursors[word] + words[word].count - 1]);
+        }
+        if (words.empty() || max_position - min_position <= max_span) {
+            return true;
+        }
+        ++cursors[min_word];
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "term_dictionary.h"
+
+// Positions of the words of one document (stop words are not counted), grouped by term in ascending
+// term id order, i.e. in the order of the document's term vector. Every group is a run of varint-encoded
+// position gaps and is decoded only when a phrase query asks for it.
+class DocumentPositions {
+public:
+    DocumentPositions() = default;
+    // word_terms[i] is the term of the i-th word of the document
+    explicit DocumentPositions(const std::vector<TermId>& word_terms);
+    // offsets has one entry per term plus the end of data
+    DocumentPositions(std::vector<uint32_t> offsets, std::vector<uint8_t> data);
+
+    size_t TermCount() const;
+    // Fills positions with the ascending positions of the term_index-th term
+    void Decode(size_t term_index, std::vector<uint32_t>& positions) const;
+
+    const std::vector<uint32_t>& Offsets() const;
+    const std::vector<uint8_t>& Data() const;
+    size_t MemoryUsage() const;
+
+private:
+    std::vector<uint32_t> offsets_{ 0 };
+    std::vector<uint8_t> data_;
+};
+
+// positions[i] are the ascending positions of the i-th query word.
+// True if the words occur one right after another in the given order
+bool HasPhrase(std::span<const std::vector<uint32_t>> positions);
+// True if, in any order, all the words occur within positions.size() + slop consecutive words; a word given
+// k times must occur k times there
+bool HasWindow(std::span<const std::vector<uint32_t>> positions, uint32_t slop);